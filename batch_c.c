@@ -0,0 +1,154 @@
+// Batch runner for the C64 BASIC emulator, the c64run mode. Is included by C64_BASIC_EMU.c, after rewind_c.c.
+// The machine boots once to READY (or from a snapshot), and that is the template for a instance per program. A worker process per core
+// (fork, the template is shared copy on write) takes the next program, loads it, types RUN and runs it until BASIC is READY again, waits for
+// INPUT, or the cycle or time limit. What it prints is captured with the CHROUT trap. The result is one JSON line on stdout per program.
+// Everything else the emulator prints goes to stderr in batch mode, so stdout is only the JSON.
+
+#include <sys/wait.h>
+#include <sched.h>
+
+#define BATCH_MAX_CYCLES	(CIA_CLOCK * 60ULL)		// Default limit, a minute of C64 time
+#define BATCH_LOOK_EVERY	(VIC_CYCLES_PER_LINE * VIC_RASTER_LINES)	// Look for READY and the limits every frame
+#define BATCH_CURLIN		0x39		// BASIC line number, 0xFFxx in direct mode
+
+typedef struct { // Shared by the workers
+	_Atomic unsigned next;		// Next program to run
+	_Atomic int      lock;		// For writing a result line
+} batch_shared;
+
+static const char **batch_files;
+static int          batch_count;
+static int          batch_jobs;			// Workers, 0 = one per core
+static uint64_t     batch_max_cycles = BATCH_MAX_CYCLES;
+static double       batch_max_seconds;		// Host time limit per program, 0 = none
+static batch_shared *batch_state;
+static int          batch_out;			// The real stdout, for the results
+
+/// Add a program to the batch.
+void batch_add(const char *name){
+	batch_files = realloc(batch_files, (batch_count + 1) * sizeof(*batch_files));
+	if(!batch_files){ printf("Out of memory for the batch\n"); exit(1); }
+	batch_files[batch_count++] = name;
+}
+
+static double batch_since(const struct timespec *start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static const char *batch_run(uint64_t until, const struct timespec *start){ // Run until READY or a limit, returns why it stopped
+	uint64_t look = clockticks6502;
+	while(1){
+		if(clockticks6502 >= look){
+			if(sched_when(paste_event) == SCHED_NEVER && !sysram[PASTE_KEYBUF_COUNT] && editor_waiting()) return sysram[BATCH_CURLIN + 1] == 0xFF ? "ready" : "input";
+			if(clockticks6502 >= until) return "cycles";
+			if(batch_max_seconds > 0 && batch_since(start) >= batch_max_seconds) return "time";
+			look = clockticks6502 + BATCH_LOOK_EVERY;
+		}
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+}
+
+static void batch_json_string(FILE *f, const char *s, size_t len){
+	fputc('"', f);
+	for(size_t i = 0 ; i < len ; i++){
+		uint8_t c = s[i];
+		if(c == '"' || c == '\\')	fprintf(f, "\\%c", c);
+		else if(c == '\n')		fputs("\\n", f);
+		else if(c < 0x20)		fprintf(f, "\\u%04x", c);
+		else				fputc(c, f);	// UTF-8 is kept as it is
+	}
+	fputc('"', f);
+}
+
+static void batch_result(const char *text, size_t len){ // One write of the whole line, while no other worker writes
+	while(atomic_exchange(&batch_state->lock, 1)) sched_yield();
+	while(len){
+		ssize_t n = write(batch_out, text, len);
+		if(n <= 0) break;
+		text += n;
+		len  -= n;
+	}
+	atomic_store(&batch_state->lock, 0);
+}
+
+static void batch_job(const char *name){ // Run one program in a new instance from the template
+	char  *output = NULL, *line = NULL;
+	size_t output_len = 0, line_len = 0;
+	FILE  *capture = open_memstream(&output, &output_len);
+	if(!capture){ printf("Out of memory for the batch\n"); exit(1); }
+	instance *i = instance_new();
+	if(!i || !(i->chrout = chrout_open(capture)) || !instance_enter(i)){ printf("Out of memory for the batch\n"); exit(1); }
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint64_t cycles = clockticks6502;
+	const char *reason = "load error";
+	if(prg_load_file(name)){
+		reason = paste_text("RUN\n", 4, 0) ? batch_run(clockticks6502 + batch_max_cycles, &start) : "out of memory";
+	}
+	cycles = clockticks6502 - cycles;
+	double host = batch_since(&start);
+	paste_cancel();
+	chrout_close(i->chrout);
+	i->chrout = NULL;
+	fclose(capture);
+	instance_free(i);
+
+	FILE *f = open_memstream(&line, &line_len);
+	if(!f){ printf("Out of memory for the batch\n"); exit(1); }
+	fputs("{\"file\":", f);
+	batch_json_string(f, name, strlen(name));
+	fprintf(f, ",\"reason\":\"%s\",\"cycles\":%llu,\"emulated_s\":%.6f,\"host_s\":%.6f,\"output\":", reason, (unsigned long long)cycles, (double)cycles / CIA_CLOCK, host);
+	batch_json_string(f, output, output_len);
+	fputs("}\n", f);
+	fclose(f);
+	batch_result(line, line_len);
+	free(line);
+	free(output);
+}
+
+static void batch_worker(const snapshot_state *template){
+	instance_set_template(template);
+	unsigned n;
+	while((n = atomic_fetch_add(&batch_state->next, 1)) < (unsigned)batch_count) batch_job(batch_files[n]);
+	fflush(stdout);
+}
+
+/// Run the programs added with batch_add(). Call when the machine is set up, instead of the main loop. Returns the exit status.
+int batch_main(void){
+	fflush(stdout);
+	batch_out = dup(1);
+	dup2(2, 1); // Only the results on stdout
+	uint64_t until = clockticks6502 + SNAPSHOT_BOOT_MAX;
+	while(!editor_waiting()){
+		if(clockticks6502 > until){ printf("BASIC didn't get READY\n"); return 1; }
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+	snapshot_state *template = malloc(sizeof(snapshot_state));
+	batch_state = mmap(NULL, sizeof(batch_shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(!template || batch_state == MAP_FAILED){ printf("Out of memory for the batch\n"); return 1; }
+	snapshot_take(template);
+	vic_no_frames = 1;
+	chrout_init();
+	int jobs = batch_jobs > 0 ? batch_jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(jobs > batch_count) jobs = batch_count;
+	if(jobs <= 1){
+		batch_worker(template);
+		return 0;
+	}
+	fflush(stdout);
+	for(int w = 0 ; w < jobs ; w++){
+		pid_t pid = fork();
+		if(pid < 0){ printf("Can't start a worker\n"); break; }
+		if(!pid){
+			batch_worker(template);
+			_exit(0);
+		}
+	}
+	int status, failed = 0;
+	while(wait(&status) > 0) if(!WIFEXITED(status) || WEXITSTATUS(status)) failed = 1;
+	return failed;
+}
@@ -0,0 +1,82 @@
+/// @file c64basic.h The C64 BASIC emulator as a library (libc64basic), for running C64 machines inside another program.
+// Build C64_BASIC_EMU.c with -DC64_LIBRARY, there is no main() and no window:
+//	gcc -O2 -fPIC -shared -fvisibility=hidden -DC64_LIBRARY C64_BASIC_EMU.c -o libc64basic.so
+// The emulation is one machine in globals, so the whole 6510 loop with the memory map is compiled in one unit and inlined. A c64_machine is a
+// copy on write instance of the power on state, and every call switches to its machine first (only the pages the machines have of their own
+// are copied). The calls are not thread safe, use one thread or a process per thread. There are no callbacks per instruction: a
+// c64_run() runs the given cycles inside the library, and what BASIC prints comes to the CHROUT callback in chunks.
+// If there is no memory to switch to another machine, the call does nothing and returns 0 (the machine that ran is still there).
+
+#ifndef C64BASIC_H
+#define C64BASIC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define C64_API __attribute__((visibility("default")))
+
+#define C64_SCREEN_TEXT_MAX	10026	// Bytes for c64_screen(), the 40x25 screen as UTF-8 with colors
+
+// Keys for c64_key() that are not characters, they are X11 key symbols. A printable ASCII char is its own key.
+#define C64_KEY_RETURN		0xFF0D
+#define C64_KEY_DEL		0xFF08
+#define C64_KEY_INST		0xFF63
+#define C64_KEY_HOME		0xFF50	// With SHIFT it's CLR
+#define C64_KEY_LEFT		0xFF51
+#define C64_KEY_UP		0xFF52
+#define C64_KEY_RIGHT		0xFF53
+#define C64_KEY_DOWN		0xFF54
+#define C64_KEY_STOP		0xFF1B	// RUN/STOP
+#define C64_KEY_RESTORE		0xFF55
+#define C64_KEY_F1		0xFFBE	// F2 - F8 follows
+#define C64_KEY_SHIFT		0xFFE1
+#define C64_KEY_CTRL		0xFFE3
+#define C64_KEY_CBM		0xFFE9	// Commodore key
+
+typedef struct c64_machine c64_machine;
+
+/// The ROMs, 8K BASIC, 8K KERNAL and 4K characters. Call before the first c64_create(). Returns 0 if a machine is made already.
+C64_API int c64_load_roms(const uint8_t *basic, const uint8_t *kernal, const uint8_t *characters);
+
+/// A new machine at power on, it boots to READY when it runs (the KERNAL RAM test is done natively). NULL if there is no memory.
+C64_API c64_machine *c64_create(void);
+C64_API void c64_destroy(c64_machine *m);
+
+/// Power on again. Returns 0 if there is no memory.
+C64_API int c64_reset(c64_machine *m);
+/// Set the machine to a snapshot file (from --snapshot). Returns 0 if it can't be used, the reason is printed.
+C64_API int c64_restore_snapshot(c64_machine *m, const char *file);
+/// Write the machine to a snapshot file. Returns 0 on error.
+C64_API int c64_save_snapshot(c64_machine *m, const char *file);
+
+/// Run for cycles (985248 a second). Returns the cycles run, can be a few more as a instruction is not split.
+C64_API uint64_t c64_run(c64_machine *m, uint64_t cycles);
+/// Run until BASIC is READY (or in INPUT), but at most cycles. Returns 1 if it got there.
+C64_API int c64_run_until_ready(c64_machine *m, uint64_t cycles);
+/// Cycles since power on.
+C64_API uint64_t c64_cycles(c64_machine *m);
+
+/// The RAM (not the ROM or I/O that can be on top of it).
+C64_API uint8_t c64_peek(c64_machine *m, uint16_t address);
+C64_API void    c64_poke(c64_machine *m, uint16_t address, uint8_t value);
+
+/// Put text in the KERNAL keyboard buffer, as much as there is room for (10 chars). Returns how much of text was taken, call again after c64_run().
+C64_API size_t c64_type(c64_machine *m, const char *text);
+/// A key down (down = 1) or up on the keyboard matrix. key is a ASCII char or a C64_KEY_. A key that is down is released when another machine runs.
+C64_API void c64_key(c64_machine *m, unsigned key, int down);
+
+/// The text screen as UTF-8 lines into out (C64_SCREEN_TEXT_MAX bytes), colors as {n} if colors is set. Returns the length.
+C64_API size_t c64_screen(c64_machine *m, char *out, int colors);
+
+/// What BASIC prints, as UTF-8, comes to callback when c64_run() returns (or in 32K chunks). NULL = not captured. Returns 0 if there is no memory.
+C64_API int c64_on_chrout(c64_machine *m, void (*callback)(void *user, const char *text, size_t len), void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
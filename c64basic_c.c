@@ -0,0 +1,163 @@
+// The library API of the C64 BASIC emulator (c64basic.h). Is included by C64_BASIC_EMU.c, last, when C64_LIBRARY is defined.
+// A machine is a instance (instance_c.c) of the power on state, with its own CHROUT stream. Every call enters its machine first.
+// The keys and the host events are the host's, keys that are down are released when the machine changes.
+
+#include "c64basic.h"
+
+_Static_assert(C64_SCREEN_TEXT_MAX == SCREEN_TEXT_MAX, "c64basic.h and screen_c.c differs");
+
+struct c64_machine {
+	instance      *instance;
+	chrout_stream *chrout;
+};
+
+static snapshot_state *c64_power_on;	// The template of every machine
+static c64_machine    *c64_active;
+static int             c64_stop_event;	// At the end of a c64_run()
+
+static void c64_stop(int param, uint64_t when){ (void)param; (void)when; } // Only makes run6502() return
+
+static int c64_start(void){ // The first machine sets up the emulator
+	c64_power_on = malloc(sizeof(snapshot_state));
+	if(!c64_power_on) return 0;
+	display_init(0, 1);
+	vic_no_frames = 1;			// Only the text screen is read
+	sysram[1] = 7;
+	pla_update();
+	cia_init();
+	reset6502();
+	vic_start();
+	keyboard_init(&mywin);
+	paste_init();
+	prg_init();
+	fastboot_init(0);
+	chrout_init();
+	c64_stop_event = sched_add("Library run end", c64_stop, 0);
+	snapshot_take(c64_power_on);
+	instance_set_template(c64_power_on);
+	return 1;
+}
+
+static int c64_enter(c64_machine *m){ // Returns 0 if there is no memory to leave the machine that runs
+	if(m == c64_active) return 1;
+	keyboard_release_all(); // The keys of the last machine, a release that waits would come on its clock
+	if(!instance_enter(m->instance)) return 0;
+	c64_active = m;
+	return 1;
+}
+
+int c64_load_roms(const uint8_t *rom_basic, const uint8_t *rom_kernal, const uint8_t *rom_characters){
+	if(c64_power_on) return 0;
+	memcpy(basic,      rom_basic,      sizeof(basic));
+	memcpy(kernal,     rom_kernal,     sizeof(kernal));
+	memcpy(characters, rom_characters, sizeof(characters));
+	return 1;
+}
+
+c64_machine *c64_create(void){
+	if(!c64_power_on && !c64_start()) return NULL;
+	c64_machine *m = calloc(1, sizeof(c64_machine));
+	if(!m) return NULL;
+	if(!(m->instance = instance_new())){ free(m); return NULL; }
+	return m;
+}
+
+void c64_destroy(c64_machine *m){
+	if(!m) return;
+	if(m == c64_active) c64_active = NULL;
+	instance_free(m->instance);
+	chrout_close(m->chrout);
+	free(m);
+}
+
+int c64_reset(c64_machine *m){
+	if(!c64_enter(m)) return 0;
+	paste_cancel();
+	snapshot_restore(c64_power_on);
+	return 1;
+}
+
+int c64_restore_snapshot(c64_machine *m, const char *file){
+	if(!c64_enter(m)) return 0;
+	paste_cancel();
+	return snapshot_load(file);
+}
+
+int c64_save_snapshot(c64_machine *m, const char *file){
+	if(!c64_enter(m)) return 0;
+	return snapshot_save(file);
+}
+
+uint64_t c64_run(c64_machine *m, uint64_t cycles){
+	if(!c64_enter(m)) return 0;
+	uint64_t start = clockticks6502, until = start + cycles;
+	sched_at(c64_stop_event, until);
+	while(clockticks6502 < until){
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+	sched_cancel(c64_stop_event);
+	chrout_flush(m->chrout);
+	return clockticks6502 - start;
+}
+
+int c64_run_until_ready(c64_machine *m, uint64_t cycles){
+	if(!c64_enter(m)) return 0;
+	uint64_t until = clockticks6502 + cycles;
+	sched_at(c64_stop_event, until);
+	while(!(editor_waiting() && !sysram[PASTE_KEYBUF_COUNT]) && clockticks6502 < until){ // The scheduler runs at least every raster line
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+	sched_cancel(c64_stop_event);
+	chrout_flush(m->chrout);
+	return editor_waiting() && !sysram[PASTE_KEYBUF_COUNT];
+}
+
+uint64_t c64_cycles(c64_machine *m){
+	if(!c64_enter(m)) return 0;
+	return clockticks6502;
+}
+
+uint8_t c64_peek(c64_machine *m, uint16_t address){
+	if(!c64_enter(m)) return 0;
+	return sysram[address];
+}
+
+void c64_poke(c64_machine *m, uint16_t address, uint8_t value){
+	if(!c64_enter(m)) return;
+	sysram[address] = value;
+	pla_written[address >> 8] = 0xFF;
+	if(address == 1) pla_update();
+}
+
+size_t c64_type(c64_machine *m, const char *text){
+	if(!c64_enter(m)) return 0;
+	uint8_t size = sysram[PASTE_KEYBUF_SIZE] < PASTE_KEYBUF_MAX ? sysram[PASTE_KEYBUF_SIZE] : PASTE_KEYBUF_MAX;
+	size_t n = 0;
+	for( ; text[n] && sysram[PASTE_KEYBUF_COUNT] < size ; n++){
+		uint8_t c = text[n];
+		if(c < 128 && paste_petscii[c]) sysram[PASTE_KEYBUF + sysram[PASTE_KEYBUF_COUNT]++] = paste_petscii[c];
+	}
+	return n;
+}
+
+void c64_key(c64_machine *m, unsigned key, int down){
+	if(!c64_enter(m)) return;
+	ikigui_key_push(&mywin, key, key, 0, down, 0);
+	keyboard_update();
+}
+
+size_t c64_screen(c64_machine *m, char *out, int colors){
+	if(!c64_enter(m)){ *out = 0; return 0; }
+	return screen_text(out, colors);
+}
+
+int c64_on_chrout(c64_machine *m, void (*callback)(void *user, const char *text, size_t len), void *user){
+	if(!c64_enter(m)) return 0;
+	chrout_close(m->chrout);
+	m->chrout = callback ? chrout_open_callback(callback, user) : NULL;
+	m->instance->chrout = m->chrout;
+	chrout_active = m->chrout;
+	return m->chrout || !callback;
+}
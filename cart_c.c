@@ -0,0 +1,126 @@
+// Cartridges (.crt files) for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after pla_c.c.
+// Normal 8K, 16K and Ultimax carts, and the bank switched Ocean, Magic Desk and EasyFlash. The ROM banks are loaded once in 8K blocks,
+// and a bank switch (a write to I/O 1 at 0xDE00) only points pla_roml and pla_romh to other blocks, nothing is copied.
+
+#define CART_BANK	0x2000
+#define CART_MAX_BANKS	128		// Magic Desk has up to 1MB
+
+enum { CART_NORMAL = 0, CART_OCEAN = 5, CART_MAGIC_DESK = 19, CART_EASYFLASH = 32 }; // Hardware types in the .crt header
+
+static uint8_t       *cart_rom;				// All the 8K blocks from the CHIP packets
+static int            cart_blocks;
+static const uint8_t *cart_roml_bank[CART_MAX_BANKS];	// The blocks for ROML and ROMH in every bank
+static const uint8_t *cart_romh_bank[CART_MAX_BANKS];
+static int            cart_type = -1;			// -1 = no cart
+static uint8_t        cart_game, cart_exrom;		// Lines from the .crt header, 0 = low
+static uint8_t        cart_ram[256];			// EasyFlash RAM at I/O 2 (0xDF00)
+static int            cart_bank_now;			// Selected bank, for snapshots
+
+static uint32_t cart_be32(const uint8_t *p){ return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint16_t cart_be16(const uint8_t *p){ return (p[0] << 8) | p[1]; }
+
+static void cart_lines(int game, int exrom){ // Set /GAME and /EXROM, the map changes if they did
+	if(game == pla_game && exrom == pla_exrom) return;
+	pla_game  = game;
+	pla_exrom = exrom;
+	pla_update();
+}
+
+static void cart_bank(int bank){
+	bank &= CART_MAX_BANKS - 1;
+	cart_bank_now = bank;
+	pla_roml = cart_roml_bank[bank];
+	pla_romh = cart_romh_bank[bank];
+	if(!pla_romh && cart_type == CART_OCEAN) pla_romh = pla_roml; // 16K Ocean carts shows the same bank at ROMH
+	pla_bank();
+}
+
+/// Back to bank 0 and the lines of the header (EasyFlash starts in Ultimax mode). Call before reset6502().
+void cart_reset(void){
+	if(cart_type < 0) return;
+	memset(cart_ram, 0, sizeof(cart_ram));
+	if(cart_type == CART_EASYFLASH) cart_lines(0, 1);
+	else				cart_lines(cart_game, cart_exrom);
+	cart_bank(0);
+}
+
+/// Load a .crt. Returns 0 if it can't be used (the reason is printed).
+int cart_load(const char *name){
+	FILE *f = fopen(name, "rb");
+	if(!f){ printf("Can't read %s\n", name); return 0; }
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *crt = malloc(len);
+	if(!crt || fread(crt, 1, len, f) != (size_t)len || len < 0x40 || memcmp(crt, "C64 CARTRIDGE   ", 16)){
+		printf("%s is not a .crt file\n", name);
+		fclose(f); free(crt); return 0;
+	}
+	fclose(f);
+	cart_type  = cart_be16(crt + 0x16);
+	cart_exrom = crt[0x18] ? 1 : 0;
+	cart_game  = crt[0x19] ? 1 : 0;
+	if(cart_type != CART_NORMAL && cart_type != CART_OCEAN && cart_type != CART_MAGIC_DESK && cart_type != CART_EASYFLASH){
+		printf("%s: cartridge hardware type %d is not supported\n", name, cart_type);
+		cart_type = -1; free(crt); return 0;
+	}
+	cart_rom = malloc(2 * CART_MAX_BANKS * CART_BANK);
+	if(!cart_rom){
+		printf("Out of memory for the cartridge\n");
+		cart_type = -1; free(crt); return 0;
+	}
+	memset(cart_rom, 0xFF, 2 * CART_MAX_BANKS * CART_BANK);
+	for(long p = cart_be32(crt + 0x10) ; p + 0x10 <= len ; ){ // CHIP packets
+		uint32_t packet = cart_be32(crt + p + 4);
+		uint16_t bank = cart_be16(crt + p + 10), address = cart_be16(crt + p + 12), size = cart_be16(crt + p + 14);
+		if(memcmp(crt + p, "CHIP", 4) || packet < 0x10 || p + 0x10 + size > len) break;
+		for(uint32_t at = 0 ; at < size && bank < CART_MAX_BANKS ; at += CART_BANK){ // A 16K chip is ROML and ROMH
+			if(cart_blocks == 2 * CART_MAX_BANKS){ // More CHIP packets than a ROML and ROMH in every bank
+				printf("%s has too many ROM chips\n", name);
+				memset(cart_roml_bank, 0, sizeof(cart_roml_bank));
+				memset(cart_romh_bank, 0, sizeof(cart_romh_bank));
+				free(cart_rom); cart_rom = NULL; cart_blocks = 0;
+				cart_type = -1; free(crt); return 0;
+			}
+			uint8_t *block = cart_rom + cart_blocks++ * CART_BANK;
+			uint32_t n = size - at < CART_BANK ? size - at : CART_BANK;
+			memcpy(block, crt + p + 0x10 + at, n);
+			if(n == 0x1000) memcpy(block + 0x1000, block, 0x1000); // 4K Ultimax ROM at 0xF000, mirrored at 0xE000
+			if(address + at == 0x8000)	cart_roml_bank[bank] = block;
+			else				cart_romh_bank[bank] = block; // 0xA000, or 0xE000 in Ultimax mode
+		}
+		p += packet;
+	}
+	free(crt);
+	cart_reset();
+	return 1;
+}
+
+/// Read of I/O 1 and I/O 2 (0xDE00 - 0xDFFF).
+uint8_t cart_io_read(uint16_t address){
+	if(cart_type == CART_EASYFLASH && address >= 0xDF00) return cart_ram[address & 0xFF];
+	return 0xFF; // Nothing drives the bus
+}
+
+/// Write to I/O 1 and I/O 2 (0xDE00 - 0xDFFF), the bank and mode registers.
+void cart_io_write(uint16_t address, uint8_t value){
+	switch(cart_type){
+		case CART_OCEAN:
+			if(address < 0xDF00) cart_bank(value & 0x3F);
+			break;
+		case CART_MAGIC_DESK:
+			if(address < 0xDF00){
+				cart_bank(value & 0x7F);
+				cart_lines(1, value >> 7); // Bit 7 turns the cart off
+			}
+			break;
+		case CART_EASYFLASH:
+			if(address >= 0xDF00)	cart_ram[address & 0xFF] = value;
+			else if(!(address & 2))	cart_bank(value & 0x3F);	// 0xDE00, the bank
+			else{							// 0xDE02, bit 0 = /GAME low (if bit 2, else the boot jumper holds it low), bit 1 = /EXROM low
+				int game = (value & 0x04) ? !(value & 0x01) : 0;
+				cart_lines(game, !(value & 0x02));
+			}
+			break;
+	}
+}
@@ -0,0 +1,138 @@
+// CHROUT capture for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after drive_c.c.
+// What the KERNAL prints on the screen (CHROUT, 0xFFD2, with the output device 3) is also converted to UTF-8 and put in a ring buffer, that is
+// written to a file in large chunks. So everything BASIC prints is kept, also what has scrolled off the screen, and the frames don't have to be drawn.
+// The trap is at the entry of CHROUT in the KERNAL, the vector at 0x0326 points there. Every machine instance can have its own stream.
+
+#define CHROUT_RING	0x10000		// Bytes in the ring
+#define CHROUT_FLUSH	0x8000		// Written to the file when this much has come
+#define CHROUT_SCREEN	3		// The output device of the screen
+
+typedef struct {
+	FILE    *out;			// The file, or...
+	void   (*callback)(void *user, const char *text, size_t len); // ...a function that gets the chunks
+	void    *user;
+	uint8_t  ring[CHROUT_RING];
+	unsigned head, tail;		// Next to write to the file, next to put in
+} chrout_stream;
+
+static chrout_stream *chrout_active;		// Of the running machine, NULL = not captured
+static void (*chrout_next_trap)(void);		// The traps that was there before (drive 8, fast boot)
+
+// PETSCII -> UTF-8 in the upper case and graphics char set. 0x60 - 0x7F prints as 0xC0 - 0xDF, and 0xE0 - 0xFE as 0xA0 - 0xBE. Colors and cursor moves are "".
+static const char *const chrout_utf8[256] = {
+	[0x0D] = "\n", [0x8D] = "\n",
+	[0x20] = " ", "!", "\"", "#", "$", "%", "&", "'", "(", ")", "*", "+", ",", "-", ".", "/",
+	"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":", ";", "<", "=", ">", "?",
+	"@", "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O",
+	"P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z", "[", "£", "]", "↑", "←",
+	[0xA0] = " ", "▌", "▄", "▔", "▁", "▏", "▒", "▕", "▒", "◤", "▕", "├", "▗", "└", "┐", "▂",
+	"┌", "┴", "┬", "┤", "▎", "▍", "▐", "▔", "▀", "▃", "┘", "▖", "▝", "┘", "▘", "▚",
+	"─", "♠", "│", "─", "─", "─", "─", "│", "│", "╮", "╰", "╯", "└", "╲", "╱", "┌",
+	"┐", "●", "▁", "♥", "▏", "╭", "╳", "○", "♣", "▕", "♦", "┼", "▒", "│", "π", "◥",
+	[0xFF] = "π",
+};
+
+// The lower case char set has the letters in both cases where the upper case set has letters and graphics, and a few other graphics
+static const char *chrout_utf8_lower[256];
+
+static void chrout_write(chrout_stream *s, const uint8_t *text, size_t len){
+	if(!len) return;
+	if(s->callback) s->callback(s->user, (const char*)text, len);
+	else		fwrite(text, 1, len, s->out);
+}
+
+static void chrout_flush_stream(chrout_stream *s){
+	if(s->head == s->tail) return;
+	unsigned from = s->head % CHROUT_RING, to = s->tail % CHROUT_RING;
+	if(from < to) chrout_write(s, &s->ring[from], to - from);
+	else{ // Wraps around
+		chrout_write(s, &s->ring[from], CHROUT_RING - from);
+		chrout_write(s, s->ring, to);
+	}
+	if(s->out) fflush(s->out);
+	s->head = s->tail;
+}
+
+/// Convert a PETSCII char to UTF-8 and put it in the stream.
+void chrout_put(chrout_stream *s, uint8_t c){
+	if(c >= 0x60 && c < 0x80) c += 0x60;
+	else if(c >= 0xE0 && c < 0xFF) c -= 0x40;
+	const char *utf8 = (vic_reg(0x18) & 0x02) ? chrout_utf8_lower[c] : chrout_utf8[c];
+	if(!utf8) return;
+	for( ; *utf8 ; utf8++) s->ring[s->tail++ % CHROUT_RING] = *utf8;
+	if(s->tail - s->head >= CHROUT_FLUSH) chrout_flush_stream(s);
+}
+
+/// A stream to out, it's not closed by the stream. NULL if there is no memory.
+chrout_stream *chrout_open(FILE *out){
+	chrout_stream *s = calloc(1, sizeof(chrout_stream));
+	if(!s) return NULL;
+	s->out = out;
+	return s;
+}
+
+/// A stream to a function, that gets the text in chunks when the ring is flushed. NULL if there is no memory.
+chrout_stream *chrout_open_callback(void (*callback)(void *user, const char *text, size_t len), void *user){
+	chrout_stream *s = chrout_open(NULL);
+	if(!s) return NULL;
+	s->callback = callback;
+	s->user     = user;
+	return s;
+}
+
+/// Write what is in the ring to the file.
+void chrout_flush(chrout_stream *s){ if(s) chrout_flush_stream(s); }
+
+/// Flush and free the stream.
+void chrout_close(chrout_stream *s){
+	if(!s) return;
+	if(s == chrout_active) chrout_active = NULL;
+	chrout_flush_stream(s);
+	free(s);
+}
+
+static void chrout_trap(void){
+	if(pc == TRAP_CHROUT && chrout_active && sysram[KERNAL_DFLTO] == CHROUT_SCREEN && pla_read[pc >> 8] == &kernal[(pc - 0xE000) & 0xFF00]) chrout_put(chrout_active, a);
+	if(chrout_next_trap) chrout_next_trap();
+}
+
+static void chrout_make_lower(void){ // chrout_utf8_lower from chrout_utf8
+	if(chrout_utf8_lower[' ']) return; // Made already
+	for(int c = 0 ; c < 256 ; c++) chrout_utf8_lower[c] = chrout_utf8[c];
+	static const char *const lower[26] = { "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z" };
+	for(int c = 0 ; c < 26 ; c++){
+		chrout_utf8_lower[0x41 + c] = lower[c];
+		chrout_utf8_lower[0xC1 + c] = chrout_utf8[0x41 + c];	// 0x61 - 0x7A prints as these
+	}
+	chrout_utf8_lower[0xA9] = "▨";
+	chrout_utf8_lower[0xBA] = "✓";
+	chrout_utf8_lower[0xDE] = "▒";
+	chrout_utf8_lower[0xDF] = "▨";
+	chrout_utf8_lower[0xFF] = "▒";
+}
+
+/// Capture from now on, to chrout_active. Call after drive_init(), the traps that are there are kept.
+void chrout_init(void){
+	chrout_make_lower();
+	if(trap6502 == chrout_trap) return; // Is on already
+	chrout_next_trap = trap6502;
+	trap_page[TRAP_CHROUT >> 8] = 1;
+	trap6502 = chrout_trap;
+}
+
+static chrout_stream *chrout_main;	// --chrout, flushed at exit
+static void chrout_end(void){ chrout_flush(chrout_main); }
+
+/// Capture to the file name, "-" is stdout. Returns 0 if it can't be written.
+int chrout_capture(const char *name){
+	FILE *out = strcmp(name, "-") ? fopen(name, "w") : stdout;
+	if(!out) return 0;
+	if(!(chrout_main = chrout_open(out))){
+		if(out != stdout) fclose(out);
+		return 0;
+	}
+	chrout_active = chrout_main;
+	chrout_init();
+	atexit(chrout_end);
+	return 1;
+}
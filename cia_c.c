@@ -0,0 +1,218 @@
+// CIA 6526 emulation for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after cpu_c.c.
+// CIA #1 (0xDC00) has the keyboard and is connected to the IRQ line, CIA #2 (0xDD00) has the VIC-II bank bits and is connected to the NMI line.
+// The timers are not counted down every cycle. A timer remembers its value at a cycle, is calculated from clockticks6502 when it's read,
+// and its next underflow (and every TOD tick) is a scheduler event.
+
+#define CIA_CLOCK	985248			// PAL phi2 in Hz
+#define CIA_TOD_TICK	(CIA_CLOCK / 10)	// Cycles between the 1/10 s TOD ticks (made from the 50 Hz mains in the real thing)
+
+typedef struct {
+	uint8_t  pra, prb, ddra, ddrb;	// Ports
+	uint16_t latch[2];		// Timer A and B reload value
+	uint16_t counter[2];		// Timer value...
+	uint64_t base[2];		// ...at this cycle
+	uint64_t underflow[2];		// Cycle of the next underflow, SCHED_NEVER if the timer is stopped or counts something else
+	int      timer_event[2];	// Scheduler events for the underflows...
+	int      tod_event;		// ...and the TOD ticks
+	uint8_t  cr[2];			// CRA and CRB
+	uint8_t  icr;			// Interrupt flags
+	uint8_t  icr_mask;		// Interrupt enabled
+	uint8_t  sdr;			// Serial shift register, not shifted
+	uint8_t  tod[4];		// TOD clock in BCD, 1/10 s, seconds, minutes, hours (bit 7 = PM)
+	uint8_t  alarm[4];		// TOD alarm
+	uint8_t  tod_latch[4];		// Read latch, hours locks it until 1/10 s is read
+	uint8_t  tod_latched;
+	uint8_t  tod_stopped;		// Writing hours stops the clock until 1/10 s is written
+	uint8_t  irq;			// The interrupt output (IRQ for CIA #1, NMI for CIA #2)
+} cia_chip;
+
+cia_chip cia[2];
+
+// Register names, only used when tracing I/O.
+static const char *cia_reg_name[16] = {
+	"Port A data", "Port B data", "Port A Direction", "Port B Direction", "Timer A Low", "Timer A High", "Timer B Low", "Timer B High",
+	"Real Time Clock 1/10s", "Real Time Clock Seconds", "Real Time Clock Minutes", "Real Time Clock Hours", "Serial shift register", "Interrupt Control and status", "Control Timer A (CRA)", "Control Timer B (CRB)"
+};
+
+static void cia_irq_output(cia_chip *c){ // CIA #1 drives IRQ, CIA #2 drives NMI
+	if(c == &cia[0])	irq_set(IRQ_CIA1, c->irq);
+	else			nmi_set(NMI_CIA2, c->irq);
+}
+
+static int cia_counts_cycles(cia_chip *c, int t){ // Timer is started and counts phi2. Timer B can count timer A underflows instead.
+	if(!(c->cr[t] & 0x01)) return 0;
+	return t == 0 ? !(c->cr[0] & 0x20) : !(c->cr[1] & 0x60);
+}
+
+static void cia_timer_start(cia_chip *c, int t, uint64_t now){ // Timer value is valid at now, find the next underflow
+	c->base[t] = now;
+	c->underflow[t] = cia_counts_cycles(c, t) ? now + c->counter[t] + 1 : SCHED_NEVER; // Counts down to 0, underflows on the next cycle
+	sched_at(c->timer_event[t], c->underflow[t]);
+}
+
+static uint16_t cia_timer_value(cia_chip *c, int t, uint64_t now){
+	if(c->underflow[t] == SCHED_NEVER) return c->counter[t];
+	uint64_t elapsed = now - c->base[t];
+	return elapsed >= c->counter[t] ? 0 : c->counter[t] - (uint16_t)elapsed;
+}
+
+static void cia_set_flag(cia_chip *c, uint8_t flag){
+	c->icr |= flag;
+	if((c->icr & c->icr_mask) && !c->irq){
+		c->irq = 1;
+		cia_irq_output(c);
+	}
+}
+
+static void cia_timer_underflow(cia_chip *c, int t, uint64_t when){
+	cia_set_flag(c, t ? 0x02 : 0x01);
+	c->counter[t] = c->latch[t];
+	if(c->cr[t] & 0x08) c->cr[t] &= ~0x01; // One shot, stops the timer
+	cia_timer_start(c, t, when);
+
+	if(t == 0 && (c->cr[1] & 0x61) == 0x41){ // Timer B counts timer A underflows
+		if(c->counter[1]-- == 0) cia_timer_underflow(c, 1, when);
+	}
+}
+
+static uint8_t cia_bcd_inc(uint8_t v){ return (v & 0x0F) == 9 ? (v & 0xF0) + 0x10 : v + 1; }
+
+static void cia_tod_tick(cia_chip *c){
+	c->tod[0] = (c->tod[0] + 1) & 0x0F;
+	if(c->tod[0] == 10){
+		c->tod[0] = 0;
+		c->tod[1] = cia_bcd_inc(c->tod[1]);
+		if(c->tod[1] == 0x60){
+			c->tod[1] = 0;
+			c->tod[2] = cia_bcd_inc(c->tod[2]);
+			if(c->tod[2] == 0x60){
+				c->tod[2] = 0;
+				uint8_t pm = c->tod[3] & 0x80, h = c->tod[3] & 0x1F;
+				if(h == 0x11)		pm ^= 0x80;	// 11 -> 12 toggles AM/PM
+				if(h == 0x12)		h = 0x01;
+				else			h = cia_bcd_inc(h);
+				c->tod[3] = pm | h;
+			}
+		}
+	}
+	if(!memcmp(c->tod, c->alarm, 4)) cia_set_flag(c, 0x04);
+}
+
+static void cia_event_timer(int param, uint64_t when){ // param is chip * 2 + timer
+	cia_timer_underflow(&cia[param >> 1], param & 1, when);
+}
+
+static void cia_event_tod(int n, uint64_t when){
+	if(!cia[n].tod_stopped) cia_tod_tick(&cia[n]);
+	sched_at(cia[n].tod_event, when + CIA_TOD_TICK);
+}
+
+void cia_reset(void){
+	for(int n = 0 ; n < 2 ; n++){
+		cia_chip *c = &cia[n];
+		int timer_event[2] = { c->timer_event[0], c->timer_event[1] }, tod_event = c->tod_event;
+		memset(c, 0, sizeof(cia_chip));
+		c->timer_event[0] = timer_event[0];
+		c->timer_event[1] = timer_event[1];
+		c->tod_event      = tod_event;
+		c->latch[0] = c->latch[1] = c->counter[0] = c->counter[1] = 0xFFFF;
+		c->underflow[0] = c->underflow[1] = SCHED_NEVER;
+		sched_cancel(c->timer_event[0]);
+		sched_cancel(c->timer_event[1]);
+		c->tod[3] = 0x01; // 1:00:00.0 AM
+		sched_at(c->tod_event, clockticks6502 + CIA_TOD_TICK);
+		cia_irq_output(c);
+	}
+}
+
+void cia_init(void){ // Register the scheduler events, and reset
+	for(int n = 0 ; n < 2 ; n++){
+		cia[n].timer_event[0] = sched_add("CIA timer A", cia_event_timer, n * 2);
+		cia[n].timer_event[1] = sched_add("CIA timer B", cia_event_timer, n * 2 + 1);
+		cia[n].tod_event      = sched_add("CIA TOD",     cia_event_tod,   n);
+	}
+	cia_reset();
+}
+
+uint8_t cia_read(int n, uint8_t reg){ // CPU read from a CIA register (0x00 - 0x0F)
+	cia_chip *c = &cia[n];
+	uint64_t now = clockticks6502;
+	uint8_t value;
+	switch(reg){
+		case 0x00: return c->pra | ~c->ddra; // Inputs are pulled high
+		case 0x01:
+			value = c->prb | ~c->ddrb;
+			if(n == 0) value &= keyboard_rows(c->pra | ~c->ddra);
+			return value;
+		case 0x02: return c->ddra;
+		case 0x03: return c->ddrb;
+		case 0x04: return cia_timer_value(c, 0, now) & 0xFF;
+		case 0x05: return cia_timer_value(c, 0, now) >> 8;
+		case 0x06: return cia_timer_value(c, 1, now) & 0xFF;
+		case 0x07: return cia_timer_value(c, 1, now) >> 8;
+		case 0x08: // 1/10 s unlocks the latch
+			value = c->tod_latched ? c->tod_latch[0] : c->tod[0];
+			c->tod_latched = 0;
+			return value;
+		case 0x09:
+		case 0x0A: return c->tod_latched ? c->tod_latch[reg - 8] : c->tod[reg - 8];
+		case 0x0B: // Hours locks the latch, so a read of the whole clock is consistent
+			if(!c->tod_latched){ memcpy(c->tod_latch, c->tod, 4); c->tod_latched = 1; }
+			return c->tod_latch[3];
+		case 0x0C: return c->sdr;
+		case 0x0D: // Reading clears the flags and releases the interrupt line
+			value = c->icr | (c->irq ? 0x80 : 0);
+			c->icr = 0;
+			c->irq = 0;
+			cia_irq_output(c);
+			return value;
+		case 0x0E: return c->cr[0] & ~0x10; // Load strobe reads 0
+		case 0x0F: return c->cr[1] & ~0x10;
+	}
+	return 0xFF;
+}
+
+void cia_write(int n, uint8_t reg, uint8_t value){ // CPU write to a CIA register (0x00 - 0x0F)
+	cia_chip *c = &cia[n];
+	uint64_t now = clockticks6502;
+	int t = (reg - 4) >> 1; // Timer for register 4 - 7
+	switch(reg){
+		case 0x00: c->pra  = value; return;
+		case 0x01: c->prb  = value; return;
+		case 0x02: c->ddra = value; return;
+		case 0x03: c->ddrb = value; return;
+		case 0x04: case 0x06: c->latch[t] = (c->latch[t] & 0xFF00) | value; return;
+		case 0x05: case 0x07:
+			c->latch[t] = (c->latch[t] & 0x00FF) | (value << 8);
+			if(!(c->cr[t] & 0x01)){ c->counter[t] = c->latch[t]; c->base[t] = now; } // High byte loads a stopped timer
+			return;
+		case 0x08: case 0x09: case 0x0A: case 0x0B: {
+			uint8_t *dest = (c->cr[1] & 0x80) ? c->alarm : c->tod; // CRB bit 7 selects writing the alarm
+			if(reg == 0x08) value &= 0x0F;
+			if(reg == 0x09 || reg == 0x0A) value &= 0x7F;
+			if(reg == 0x0B) value &= 0x9F;
+			dest[reg - 8] = value;
+			if(dest == c->tod){
+				if(reg == 0x0B) c->tod_stopped = 1;	// Clock stops when hours is written...
+				if(reg == 0x08){			// ...and starts when 1/10 s is written
+					c->tod_stopped = 0;
+					sched_at(c->tod_event, now + CIA_TOD_TICK);
+				}
+			}
+			return;
+		}
+		case 0x0C: c->sdr = value; return;
+		case 0x0D: // Bit 7 set = enable the other set bits, clear = disable them
+			if(value & 0x80) c->icr_mask |=  (value & 0x1F);
+			else		 c->icr_mask &= ~(value & 0x1F);
+			if(c->icr & c->icr_mask) cia_set_flag(c, 0);
+			return;
+		case 0x0E: case 0x0F:
+			t = reg - 0x0E;
+			c->counter[t] = cia_timer_value(c, t, now); // Freeze the value where it is now...
+			c->cr[t] = value;
+			if(value & 0x10) c->counter[t] = c->latch[t]; // ...or load the latch with the strobe bit
+			cia_timer_start(c, t, now);
+			return;
+	}
+}
@@ -39,8 +39,26 @@
 uint16_t pc;
 uint8_t sp, a, x, y, cpustatus;
 
+uint64_t clockticks6502;	// CPU cycles since start, the time base for the other chips
+uint64_t instructions6502;	// Instructions since start
+
 uint16_t oldpc, ea, reladdr, value, result;
 uint8_t opcode, oldcpustatus, useaccum;
+uint8_t penaltyop, penaltyaddr;	// The instruction takes a extra cycle if the indexed address crossed a page (only loads and ALU ops, stores always take it)
+
+//interrupt lines, every source has a bit. IRQ is level triggered, NMI is edge triggered.
+#define IRQ_CIA1    0x01
+#define IRQ_VIC     0x02
+#define IRQ_CART    0x04
+#define NMI_CIA2    0x01
+#define NMI_RESTORE 0x02
+#define NMI_CART    0x04
+#define PENDING_IRQ 0x01 //some source holds IRQ low
+#define PENDING_NMI 0x02 //NMI went low, taken once
+uint8_t irq_lines, nmi_lines; //sources that hold the line low (the lines are wired-OR)
+uint8_t int_pending;          //the one thing the CPU looks at between instructions
+uint8_t trap_page[256];       //pages that have a PC trap, the host is called before a instruction in them
+void (*trap6502)(void);       //the host side of the traps, can do the routine at pc and return from it
 
 //a few general functions used by various other functions
 void push16(uint16_t pushval) {
@@ -112,6 +130,7 @@ void absx() { //absolute,X
     ea = ((uint16_t)read6502(pc) | ((uint16_t)read6502(pc+1) << 8));
     startpage = ea & 0xFF00;
     ea += (uint16_t)x;
+    if (startpage != (ea & 0xFF00)) penaltyaddr = 1; //one cycle penalty for page-crossing on some opcodes
 
     pc += 2;
 }
@@ -121,6 +140,7 @@ void absy() { //absolute,Y
     ea = ((uint16_t)read6502(pc) | ((uint16_t)read6502(pc+1) << 8));
     startpage = ea & 0xFF00;
     ea += (uint16_t)y;
+    if (startpage != (ea & 0xFF00)) penaltyaddr = 1; //one cycle penalty for page-crossing on some opcodes
 
     pc += 2;
 }
@@ -146,7 +166,7 @@ void indy() { // (indirect),Y
     ea = (uint16_t)read6502(eahelp) | ((uint16_t)read6502(eahelp2) << 8);
     startpage = ea & 0xFF00;
     ea += (uint16_t)y;
-
+    if (startpage != (ea & 0xFF00)) penaltyaddr = 1; //one cycle penalty for page-crossing on some opcodes
 }
 
 static uint16_t getvalue() {
@@ -166,6 +186,7 @@ void putvalue(uint16_t saveval) {
 
 //instruction handler functions
 void adc() {
+    penaltyop = 1;
     value = getvalue();
     result = (uint16_t)a + value + (uint16_t)(cpustatus & FLAG_CARRY);
    
@@ -194,6 +215,7 @@ void adc() {
 }
 
 void op_and() {
+    penaltyop = 1;
     value = getvalue();
     result = (uint16_t)a & value;
    
@@ -218,8 +240,8 @@ void bcc() {
     if ((cpustatus & FLAG_CARRY) == 0) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -227,8 +249,8 @@ void bcs() {
     if ((cpustatus & FLAG_CARRY) == FLAG_CARRY) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -236,8 +258,8 @@ void beq() {
     if ((cpustatus & FLAG_ZERO) == FLAG_ZERO) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -253,8 +275,8 @@ void bmi() {
     if ((cpustatus & FLAG_SIGN) == FLAG_SIGN) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -262,8 +284,8 @@ void bne() {
     if ((cpustatus & FLAG_ZERO) == 0) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -271,8 +293,8 @@ void bpl() {
     if ((cpustatus & FLAG_SIGN) == 0) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -288,8 +310,8 @@ void bvc() {
     if ((cpustatus & FLAG_OVERFLOW) == 0) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -297,8 +319,8 @@ void bvs() {
     if ((cpustatus & FLAG_OVERFLOW) == FLAG_OVERFLOW) {
         oldpc = pc;
         pc += reladdr;
-        //if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
-        //    else clockticks6502++;
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+            else clockticks6502++;
     }
 }
 
@@ -319,6 +341,7 @@ void clv() {
 }
 
 void cmp() {
+    penaltyop = 1;
     value = getvalue();
     result = (uint16_t)a - value;
    
@@ -376,6 +399,7 @@ void dey() {
 }
 
 void eor() {
+    penaltyop = 1;
     value = getvalue();
     result = (uint16_t)a ^ value;
    
@@ -419,6 +443,7 @@ void jsr() {
 }
 
 void lda() {
+    penaltyop = 1;
     value = getvalue();
     a = (uint8_t)(value & 0x00FF);
    
@@ -427,6 +452,7 @@ void lda() {
 }
 
 void ldx() {
+    penaltyop = 1;
     value = getvalue();
     x = (uint8_t)(value & 0x00FF);
    
@@ -435,6 +461,7 @@ void ldx() {
 }
 
 void ldy() {
+    penaltyop = 1;
     value = getvalue();
     y = (uint8_t)(value & 0x00FF);
    
@@ -458,6 +485,7 @@ void nop() {
 }
 
 void ora() {
+    penaltyop = 1;
     value = getvalue();
     result = (uint16_t)a | value;
    
@@ -521,6 +549,7 @@ void rts() {
 }
 
 void sbc() {
+    penaltyop = 1;
     value = getvalue() ^ 0x00FF;
     result = (uint16_t)a + value + (uint16_t)(cpustatus & FLAG_CARRY);
    
@@ -666,22 +695,37 @@ void tya() {
 #endif
 
 
+void irq_set(uint8_t source, int active) { //a device sets or releases its IRQ output
+    if (active) irq_lines |= source;
+        else irq_lines &= ~source;
+    if (irq_lines) int_pending |= PENDING_IRQ;
+        else int_pending &= ~PENDING_IRQ;
+}
+
+void nmi_set(uint8_t source, int active) { //a device sets or releases its NMI output, only the first source pulling it low makes a NMI
+    if (active) {
+        if (!nmi_lines) int_pending |= PENDING_NMI;
+        nmi_lines |= source;
+    } else nmi_lines &= ~source;
+}
+
 void nmi6502() {
     push16(pc);
-    push8(cpustatus);
+    push8((cpustatus | FLAG_CONSTANT) & ~FLAG_BREAK); //B is only set on the stack by BRK, the KERNAL IRQ handler looks at it
     cpustatus |= FLAG_INTERRUPT;
     pc = (uint16_t)read6502(0xFFFA) | ((uint16_t)read6502(0xFFFB) << 8);
+    clockticks6502 += 7;
 }
 
 void irq6502() {
     push16(pc);
-    push8(cpustatus);
+    push8((cpustatus | FLAG_CONSTANT) & ~FLAG_BREAK);
     cpustatus |= FLAG_INTERRUPT;
     pc = (uint16_t)read6502(0xFFFE) | ((uint16_t)read6502(0xFFFF) << 8);
+    clockticks6502 += 7;
 }
 
-#ifdef USE_TIMING
-prog_char ticktable[256] PROGMEM = {
+static const uint8_t ticktable[256] = {
 /*        |  0  |  1  |  2  |  3  |  4  |  5  |  6  |  7  |  8  |  9  |  A  |  B  |  C  |  D  |  E  |  F  |     */
 /* 0 */      7,    6,    2,    8,    3,    3,    5,    5,    3,    2,    2,    2,    4,    4,    6,    6,  /* 0 */
 /* 1 */      2,    5,    2,    8,    4,    4,    6,    6,    2,    4,    2,    7,    4,    4,    7,    7,  /* 1 */
@@ -700,20 +744,14 @@ prog_char ticktable[256] PROGMEM = {
 /* E */      2,    6,    2,    8,    3,    3,    5,    5,    2,    2,    2,    2,    4,    4,    6,    6,  /* E */
 /* F */      2,    5,    2,    8,    4,    4,    6,    6,    2,    4,    2,    7,    4,    4,    7,    7   /* F */
 };
-#endif
 
-void exec6502() {
-#ifdef USE_TIMING
-  clockgoal6502 += tickcount;
-   
-  while (clockgoal6502 > 0) {
-#else
-  //while (tickcount--) {
-#endif
+void exec6502() { //run one instruction
     opcode = read6502(pc++);
     cpustatus |= FLAG_CONSTANT;
 
     useaccum = 0;
+    penaltyop = 0;
+    penaltyaddr = 0;
 
 		switch (opcode) {
 		case 0x0:	imp();	brk6502();	break;
@@ -868,11 +906,31 @@ void exec6502() {
 		case 0xFD:	absx();	sbc();	break;
 		case 0xFE:	absx();	inc();	break;
 		}
-#ifdef USE_TIMING
-      clockgoal6502 -= (int32_t)pgm_read_byte_near(ticktable + opcode);
-#endif
-      //instructions++;
-  //} //while
+      clockticks6502 += ticktable[opcode] + (penaltyop & penaltyaddr);
+      instructions6502++;
+}
+
+static void interrupt6502() { //something is pending, NMI first, IRQ if it isn't masked
+    if (int_pending & PENDING_NMI) {
+        int_pending &= ~PENDING_NMI;
+        nmi6502();
+    } else if (!(cpustatus & FLAG_INTERRUPT)) irq6502();
+}
+
+void run6502(const uint64_t *until) { //run instructions until the cycle counter reaches *until (a few cycles after, instructions are not split). It's read every instruction, so a write to a device can move it earlier.
+    while (clockticks6502 < *until) {
+        if (trap_page[pc >> 8]) trap6502();
+        exec6502();
+        if (int_pending) interrupt6502();
+    }
+}
+
+uint64_t getclockticks() { //cycles since start, for pacing and profiling
+  return(clockticks6502);
+}
+
+uint64_t getinstructions() {
+  return(instructions6502);
 }
 
 uint16_t getpc() {
@@ -0,0 +1,299 @@
+// D64 disk images for drive 8 of the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, before drive_c.c that uses it.
+// The image is mmap'ed private: the emulator reads it in place, and writes (SAVE, scratch, rename) are copy on write in this process only,
+// so many emulators can use the same image file and it's never changed. The directory is read once into a hash map on the file names,
+// so finding a file is one lookup, and a LOAD copies the data of the sector chain straight into the RAM.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define D64_SECTOR		256
+#define D64_DATA		254			// Data bytes in a sector, after the link to the next one
+#define D64_DIR_TRACK		18			// BAM in sector 0, the directory from sector 1
+#define D64_MAX_FILES		144			// 18 directory sectors with 8 files each
+#define D64_HASH		256			// Slots in the name hash map, a power of two over D64_MAX_FILES
+#define D64_MAX_SECTORS		768			// 40 tracks, a longer chain is broken
+
+typedef struct {
+	char     name[17];		// Host chars, like the KERNAL names in drive_c.c
+	uint8_t  type;			// 0x81 SEQ, 0x82 PRG, 0x83 USR... (bit 7 = closed)
+	uint8_t  track, sector;		// First sector of the data
+	uint16_t blocks;
+	uint32_t entry;			// Offset of the directory entry in the image
+} d64_file;
+
+static uint8_t *d64_image;			// The mmap'ed image
+static size_t   d64_size;
+static int      d64_tracks;			// 35 or 40
+static uint32_t d64_track_offset[42];		// Offset of sector 0 of every track
+static d64_file d64_files[D64_MAX_FILES];	// In directory order
+static int      d64_count;
+static int16_t  d64_hash[D64_HASH];		// Index in d64_files, -1 = empty
+
+static int d64_sectors(int track){ return track <= 17 ? 21 : track <= 24 ? 19 : track <= 30 ? 18 : 17; }
+
+static uint8_t *d64_sector(int track, int sector){ // NULL if it's not on the disk
+	if(track < 1 || track > d64_tracks || sector < 0 || sector >= d64_sectors(track)) return NULL;
+	return &d64_image[d64_track_offset[track] + sector * D64_SECTOR];
+}
+
+static char d64_to_host(uint8_t c){ return c >= 0x41 && c <= 0x5A ? c + 0x20 : c >= 0xC1 && c <= 0xDA ? c - 0x80 : c; }
+static uint8_t d64_to_petscii(char c){ return c >= 'a' && c <= 'z' ? c - 0x20 : c >= 'A' && c <= 'Z' ? c + 0x80 : c; }
+
+static uint32_t d64_name_hash(const char *name){ // FNV-1a
+	uint32_t h = 2166136261u;
+	while(*name) h = (h ^ (uint8_t)*name++) * 16777619u;
+	return h;
+}
+
+static void d64_index(void){ // Read the directory into d64_files and the hash map
+	d64_count = 0;
+	memset(d64_hash, 0xFF, sizeof(d64_hash));
+	int track = D64_DIR_TRACK, sector = 1, chain = 0;
+	uint8_t *s;
+	while((s = d64_sector(track, sector)) && chain++ < D64_MAX_FILES / 8){
+		for(int i = 0 ; i < 8 && d64_count < D64_MAX_FILES ; i++){
+			uint8_t *e = s + i * 32;
+			if(!(e[2] & 0x07) || !(e[2] & 0x80)) continue; // Deleted, or not closed (a splat file)
+			d64_file *f = &d64_files[d64_count];
+			int n = 0;
+			while(n < 16 && e[5 + n] != 0xA0) f->name[n] = d64_to_host(e[5 + n]), n++;
+			f->name[n] = 0;
+			f->type   = e[2];
+			f->track  = e[3];
+			f->sector = e[4];
+			f->blocks = e[30] | (e[31] << 8);
+			f->entry  = e - d64_image;
+			uint32_t h = d64_name_hash(f->name);
+			while(d64_hash[h & (D64_HASH - 1)] >= 0){ // The first one with a name is the one the drive finds
+				if(!strcmp(d64_files[d64_hash[h & (D64_HASH - 1)]].name, f->name)) break;
+				h++;
+			}
+			if(d64_hash[h & (D64_HASH - 1)] < 0) d64_hash[h & (D64_HASH - 1)] = d64_count;
+			d64_count++;
+		}
+		track  = s[0];
+		sector = s[1];
+	}
+}
+
+/// mmap a .d64 as the disk. Returns 0 if it's not a D64 image.
+int d64_open(const char *path){
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return 0;
+	struct stat st;
+	fstat(fd, &st);
+	d64_size = st.st_size;
+	if(d64_size == 174848 || d64_size == 175531)		d64_tracks = 35; // With or without the error bytes
+	else if(d64_size == 196608 || d64_size == 197376)	d64_tracks = 40;
+	else{ close(fd); return 0; }
+	d64_image = mmap(NULL, d64_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0); // Private, writes are never in the file
+	close(fd);
+	if(d64_image == MAP_FAILED){ d64_image = NULL; return 0; }
+	for(int t = 1, offset = 0 ; t <= d64_tracks + 1 ; t++){ d64_track_offset[t] = offset; offset += d64_sectors(t) * D64_SECTOR; }
+	d64_index();
+	return 1;
+}
+
+static int d64_match(const char *pattern, const char *name){ // * matches the rest and ? any char, like the 1541 (case is the PETSCII shift here)
+	for( ; *pattern ; pattern++, name++){
+		if(*pattern == '*') return 1;
+		if(!*name || (*pattern != '?' && *pattern != *name)) return 0;
+	}
+	return !*name;
+}
+
+/// The file with the name, or the first one in the directory that matches wildcards. NULL if none.
+d64_file *d64_find(const char *pattern){
+	if(!strpbrk(pattern, "*?")){
+		for(uint32_t h = d64_name_hash(pattern) ; d64_hash[h & (D64_HASH - 1)] >= 0 ; h++){
+			d64_file *f = &d64_files[d64_hash[h & (D64_HASH - 1)]];
+			if(!strcmp(f->name, pattern)) return f;
+		}
+		return NULL;
+	}
+	for(int i = 0 ; i < d64_count ; i++) if(d64_match(pattern, d64_files[i].name)) return &d64_files[i];
+	return NULL;
+}
+
+/// Copy the data of a file, from byte skip, to dst. Returns the bytes copied, max at most.
+size_t d64_read(const d64_file *f, size_t skip, uint8_t *dst, size_t max){
+	size_t n = 0;
+	int track = f->track, sector = f->sector, chain = 0;
+	uint8_t *s;
+	while(n < max && (s = d64_sector(track, sector)) && chain++ < D64_MAX_SECTORS){
+		size_t len = s[0] ? D64_DATA : (s[1] >= 1 ? s[1] - 1 : 0); // The last sector has the index of the last byte instead of a link
+		size_t from = skip < len ? skip : len;
+		skip -= from;
+		len  -= from;
+		if(len > max - n) len = max - n;
+		memcpy(dst + n, s + 2 + from, len);
+		n += len;
+		if(!s[0]) break;
+		track  = s[0];
+		sector = s[1];
+	}
+	return n;
+}
+
+static uint8_t *d64_bam(int track){ return d64_sector(D64_DIR_TRACK, 0) + 4 + (track - 1) * 4; } // Free count and 3 bytes of bits, 1 = free (tracks 1 - 35)
+
+static int d64_blocks_free(void){
+	int n = 0;
+	for(int t = 1 ; t <= 35 ; t++) if(t != D64_DIR_TRACK) n += d64_bam(t)[0];
+	return n;
+}
+
+static void d64_use(int track, int sector, int used){ // Mark a sector in the BAM
+	if(track > 35) return; // The extra tracks of a 40 track image are not in the standard BAM
+	uint8_t *b = d64_bam(track), bit = 1 << (sector & 7);
+	if(used && (b[1 + sector / 8] & bit)){ b[1 + sector / 8] &= ~bit; b[0]--; }
+	if(!used && !(b[1 + sector / 8] & bit)){ b[1 + sector / 8] |= bit; b[0]++; }
+}
+
+static int d64_alloc(int *track, int *sector, int dir){ // A free sector, on the track closest to the directory like the DOS (or on the directory track). Returns 0 if the disk is full.
+	for(int d = dir ? 0 : 1 ; d < 35 ; d++){
+		for(int side = 0 ; side < 2 ; side++){
+			int t = side ? D64_DIR_TRACK + d : D64_DIR_TRACK - d;
+			if(t < 1 || t > 35 || (d == 0 && side) || (!dir && t == D64_DIR_TRACK)) continue;
+			uint8_t *b = d64_bam(t);
+			if(!b[0]) continue;
+			for(int s = 0 ; s < d64_sectors(t) ; s++){
+				if(b[1 + s / 8] & (1 << (s & 7))){ *track = t; *sector = s; d64_use(t, s, 1); return 1; }
+			}
+		}
+		if(dir) return 0;
+	}
+	return 0;
+}
+
+static void d64_free_chain(int track, int sector){
+	uint8_t *s;
+	for(int chain = 0 ; (s = d64_sector(track, sector)) && chain < D64_MAX_SECTORS ; chain++){
+		d64_use(track, sector, 0);
+		if(!s[0]) break;
+		track  = s[0];
+		sector = s[1];
+	}
+}
+
+/// Scratch the files that match, returns how many.
+int d64_scratch(const char *pattern){
+	int n = 0;
+	d64_file *f;
+	while((f = d64_find(pattern))){
+		d64_free_chain(f->track, f->sector);
+		d64_image[f->entry + 2] = 0;
+		d64_index();
+		n++;
+	}
+	return n;
+}
+
+static void d64_set_name(uint8_t *entry, const char *name){
+	memset(entry + 5, 0xA0, 16);
+	for(int i = 0 ; i < 16 && name[i] ; i++) entry[5 + i] = d64_to_petscii(name[i]);
+}
+
+/// Rename a file. Returns a DOS error code, 0 = OK.
+int d64_rename(const char *new_name, const char *old_name){
+	if(d64_find(new_name)) return 63; // FILE EXISTS
+	d64_file *f = d64_find(old_name);
+	if(!f) return 62; // FILE NOT FOUND
+	d64_set_name(&d64_image[f->entry], new_name);
+	d64_index();
+	return 0;
+}
+
+static uint8_t *d64_new_entry(void){ // A free directory entry, a new directory sector is linked in if they are full
+	int track = D64_DIR_TRACK, sector = 1;
+	for(int chain = 0 ; chain < D64_MAX_FILES / 8 ; chain++){
+		uint8_t *s = d64_sector(track, sector);
+		if(!s) return NULL;
+		for(int i = 0 ; i < 8 ; i++) if(!s[i * 32 + 2]) return s + i * 32;
+		if(!s[0]){
+			int t, n;
+			if(!d64_alloc(&t, &n, 1)) return NULL;
+			uint8_t *next = d64_sector(t, n);
+			memset(next, 0, D64_SECTOR);
+			next[1] = 0xFF;
+			s[0] = t;
+			s[1] = n;
+		}
+		track  = s[0];
+		sector = s[1];
+	}
+	return NULL;
+}
+
+/// Write a file (a old one with the name is replaced), type is 'P' or 'S'. Returns a DOS error code, 0 = OK.
+int d64_write(const char *name, char type, const uint8_t *data, size_t len){
+	d64_scratch(name);
+	size_t blocks = len ? (len + D64_DATA - 1) / D64_DATA : 1;
+	if(blocks > (size_t)d64_blocks_free()) return 72; // DISK FULL
+	uint8_t *entry = d64_new_entry();
+	if(!entry) return 72;
+	int track, sector, next_track, next_sector;
+	d64_alloc(&track, &sector, 0);
+	entry[2] = type == 'S' ? 0x81 : 0x82;
+	entry[3] = track;
+	entry[4] = sector;
+	d64_set_name(entry, name);
+	memset(entry + 21, 0, 9);
+	entry[30] = blocks & 0xFF;
+	entry[31] = blocks >> 8;
+	for(size_t b = 0 ; b < blocks ; b++){
+		uint8_t *s = d64_sector(track, sector);
+		size_t n = len - b * D64_DATA < D64_DATA ? len - b * D64_DATA : D64_DATA;
+		memset(s, 0, D64_SECTOR);
+		memcpy(s + 2, data + b * D64_DATA, n);
+		if(b + 1 < blocks){
+			d64_alloc(&next_track, &next_sector, 0);
+			s[0] = track  = next_track;
+			s[1] = sector = next_sector;
+		}else s[1] = n + 1; // Index of the last byte
+	}
+	d64_index();
+	return 0;
+}
+
+/// The "$" file, made from the directory like the 1541 does it. NULL if there is no memory.
+uint8_t *d64_listing(size_t *len){
+	uint8_t *bam = d64_sector(D64_DIR_TRACK, 0), *out = malloc(48 * (d64_count + 2) + 4), *p = out;
+	uint16_t addr = 0x0801;
+	if(!out) return NULL;
+	*p++ = 0x01; *p++ = 0x08;
+	for(int i = -1 ; i <= d64_count ; i++){
+		uint8_t *line = p;
+		int blocks = i < 0 ? 0 : i == d64_count ? d64_blocks_free() : d64_files[i].blocks;
+		p += 2;
+		*p++ = blocks & 0xFF; *p++ = blocks >> 8;
+		if(i < 0){ // Reversed disk name, ID and DOS type
+			*p++ = 0x12; *p++ = '"';
+			memcpy(p, bam + 0x90, 16); p += 16;
+			*p++ = '"'; *p++ = ' ';
+			memcpy(p, bam + 0xA2, 2); p += 2;
+			*p++ = ' ';
+			memcpy(p, bam + 0xA5, 2); p += 2;
+		}else if(i == d64_count){
+			memcpy(p, "BLOCKS FREE.", 12); p += 12;
+		}else{
+			static const char *types[] = { "DEL", "SEQ", "PRG", "USR", "REL" };
+			uint8_t *e = &d64_image[d64_files[i].entry];
+			for(int s = blocks < 10 ? 3 : blocks < 100 ? 2 : 1 ; s ; s--) *p++ = ' ';
+			int n = 0;
+			*p++ = '"';
+			while(n < 16 && e[5 + n] != 0xA0) *p++ = e[5 + n++];
+			*p++ = '"';
+			for( ; n < 17 ; n++) *p++ = ' ';
+			memcpy(p, (e[2] & 7) < 5 ? types[e[2] & 7] : "???", 3); p += 3;
+		}
+		*p++ = 0;
+		addr += p - line;
+		line[0] = addr & 0xFF; line[1] = addr >> 8;
+	}
+	*p++ = 0; *p++ = 0;
+	*len = p - out;
+	return out;
+}
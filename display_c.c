@@ -0,0 +1,63 @@
+// Shows the VIC-II frame in the window. Is included by C64_BASIC_EMU.c, after vic_c.c.
+// The VIC-II draws to display_frame. When a frame is done it's compared line by line with the frame that is in the window,
+// and only the changed span of every line is scaled up (nearest neighbour, SIMD) and uploaded. A blinking cursor costs one small rectangle, not the whole 4K window.
+
+#define DISPLAY_MAX_SCALE 4
+
+uint32_t     display_frame[VIC_FRAME_LINES * VIC_FRAME_WIDTH];		// VIC-II output, display_w * display_h pixels
+ikigui_image display_image;						// display_frame as a image, to draw on top of the VIC-II output
+int display_w, display_h;						// Size of the frame, 320x200 or 384x272 with border
+int display_scale;							// Window pixels per C64 pixel (1 - DISPLAY_MAX_SCALE)
+int display_left, display_top;						// Where the display window starts in the frame
+static uint32_t display_shown[VIC_FRAME_LINES * VIC_FRAME_WIDTH];	// The frame as it is in the window now
+
+void display_init(int border, int scale){ // Call before the window is opened, the window should be display_w * display_scale x display_h * display_scale.
+	display_scale = scale < 1 ? 1 : scale > DISPLAY_MAX_SCALE ? DISPLAY_MAX_SCALE : scale;
+	display_w    = border ? VIC_FRAME_WIDTH : VIC_DISPLAY_WIDTH;
+	display_h    = border ? VIC_FRAME_LINES : VIC_DISPLAY_LINES;
+	display_left = border ? VIC_BORDER_LEFT : 0;
+	display_top  = border ? VIC_FIRST_DISPLAY_LINE - VIC_FRAME_FIRST_LINE : 0;
+	display_image.w = display_w;
+	display_image.h = display_h;
+	display_image.pixels = display_frame;
+	display_image.size = display_w * display_h;
+	memset(display_shown, 0, sizeof(display_shown)); // No palette color is 0 (alpha is 0xFF), so the first frame is all new
+	vic_init(display_frame, display_w, border);
+}
+
+#ifndef C64_HEADLESS // There is no window
+void display_present(ikigui_window *win){ // Scale and upload what has changed since last time
+	ikigui_rect rects[VIC_FRAME_LINES];
+	int count = 0;
+	int pitch = win->image.w;
+	for(int y = 0 ; y < display_h ; y++){
+		const uint32_t *now = &display_frame[y * display_w];
+		uint32_t       *old = &display_shown[y * display_w];
+		if(!memcmp(now, old, display_w * sizeof(uint32_t))) continue; // Nothing new on this line
+
+		int x0 = 0, x1 = display_w;
+		while(now[x0] == old[x0]) x0++;			// Find the changed span
+		while(now[x1 - 1] == old[x1 - 1]) x1--;
+		memcpy(old + x0, now + x0, (x1 - x0) * sizeof(uint32_t));
+
+		unsigned int *dst = &win->image.pixels[y * display_scale * pitch + x0 * display_scale];
+		ikigui_span_scale(dst, now + x0, x1 - x0, display_scale);
+		for(int r = 1 ; r < display_scale ; r++) ikigui_span_copy(dst + r * pitch, dst, (x1 - x0) * display_scale); // The other lines are copies
+
+		ikigui_rect *last = count ? &rects[count - 1] : NULL;
+		if(last && last->y + last->h == y * display_scale){ // Continues the rectangle from the line above
+			int right = last->x + last->w > x1 * display_scale ? last->x + last->w : x1 * display_scale;
+			if(x0 * display_scale < last->x) last->x = x0 * display_scale;
+			last->w  = right - last->x;
+			last->h += display_scale;
+		}else{
+			rects[count].x = x0 * display_scale;
+			rects[count].y = y * display_scale;
+			rects[count].w = (x1 - x0) * display_scale;
+			rects[count].h = display_scale;
+			count++;
+		}
+	}
+	if(count) ikigui_window_update_rects(win, rects, count);
+}
+#endif
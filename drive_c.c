@@ -0,0 +1,459 @@
+// A host directory as disk drive 8 for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after prg_c.c.
+// There is no serial bus. The KERNAL file routines are trapped on the PC where their RAM vectors (0x031A - 0x032A, 0x0330, 0x0332) point,
+// and if the device is 8 they are done on the host and return with a RTS, or jump to the KERNAL error exit. Other devices goes on in the ROM.
+// Files are read with mmap, so a LOAD of any size is one memcpy. A wedge that moves a vector to its own code is not trapped.
+// The disk is a host directory, or a D64 image (d64_c.c).
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+
+#define DRIVE_DEVICE	8
+#define DRIVE_CHANNELS	16		// Secondary addresses, 15 is the command channel
+#define DRIVE_BLOCKS	664		// Blocks on a empty 1541 disk, for BLOCKS FREE
+#define DRIVE_ROM	-1		// Trap result: not for us, the ROM routine runs
+
+// KERNAL RAM
+#define KERNAL_STATUS	0x90		// ST
+#define KERNAL_VERIFY	0x93		// LOAD = 0, VERIFY = 1
+#define KERNAL_LDTND	0x98		// Open files
+#define KERNAL_DFLTN	0x99		// Input device
+#define KERNAL_DFLTO	0x9A		// Output device
+#define KERNAL_EAL	0xAE		// End address of LOAD and SAVE
+#define KERNAL_FNLEN	0xB7
+#define KERNAL_LA	0xB8
+#define KERNAL_SA	0xB9
+#define KERNAL_FA	0xBA
+#define KERNAL_FNADR	0xBB
+#define KERNAL_STAL	0xC1		// Start address of SAVE
+#define KERNAL_MEMUSS	0xC3		// Address of LOAD with secondary address 0
+#define KERNAL_LAT	0x0259		// Logical file table...
+#define KERNAL_FAT	0x0263		// ...devices...
+#define KERNAL_SAT	0x026D		// ...and secondary addresses, 10 files
+#define KERNAL_MAX_FILES 10
+#define KERNAL_ERROR	0xF6F8		// + 3 * error number, the KERNAL error exits (LDA #n, prints I/O ERROR #n if messages are on, sets carry)
+
+enum { DRIVE_TOO_MANY_FILES = 1, DRIVE_FILE_OPEN, DRIVE_FILE_NOT_OPEN, DRIVE_FILE_NOT_FOUND, DRIVE_DEVICE_NOT_PRESENT, DRIVE_NOT_INPUT_FILE, DRIVE_NOT_OUTPUT_FILE, DRIVE_MISSING_FILE_NAME };
+
+// Where the vectors point in the KERNAL ROM
+#define TRAP_GETIN	0xF13E
+#define TRAP_CHRIN	0xF157
+#define TRAP_CHROUT	0xF1CA
+#define TRAP_CHKIN	0xF20E
+#define TRAP_CHKOUT	0xF250
+#define TRAP_CLOSE	0xF291
+#define TRAP_CLRCHN	0xF333
+#define TRAP_OPEN	0xF34A
+#define TRAP_LOAD	0xF4A5
+#define TRAP_SAVE	0xF5ED
+
+typedef struct {
+	uint8_t *data;		// File to read (mmap) or a made directory listing (malloc)...
+	size_t   len, pos;
+	int      mapped;	// ...data is mmap'ed
+	FILE    *out;		// File to write...
+	char    *mem;		// ...or for a D64 a memory stream, that is written to the image on close
+	size_t   mem_len;
+	char     name[256];
+	char     type;
+} drive_channel;
+
+static const char   *drive_dir;				// The host directory that is the disk...
+static int           drive_d64;				// ...or the D64 image
+static drive_channel drive_channels[DRIVE_CHANNELS];
+static uint8_t       drive_in, drive_out;			// Channels after CHKIN and CHKOUT
+static char          drive_command[64];			// Written to the command channel...
+static int           drive_command_len;
+static char          drive_error[40] = "73,HOST DIR DOS,00,00\r";	// ...and the error channel text, read from it
+static size_t        drive_error_pos;
+
+static void drive_set_error(int code, const char *text){ snprintf(drive_error, sizeof(drive_error), "%02d,%s,00,00\r", code, text); drive_error_pos = 0; }
+
+static int drive_raw_name(char *raw){ // The KERNAL file name (FNADR, FNLEN) as host chars, returns the length
+	int len = sysram[KERNAL_FNLEN];
+	uint16_t adr = sysram[KERNAL_FNADR] | (sysram[KERNAL_FNADR + 1] << 8);
+	for(int i = 0 ; i < len ; i++){ // PETSCII letters are lower case on the host, shifted ones upper case
+		uint8_t c = read6502(adr + i);
+		raw[i] = c >= 0x41 && c <= 0x5A ? c + 0x20 : c >= 0xC1 && c <= 0xDA ? c - 0x80 : c;
+	}
+	raw[len] = 0;
+	return len;
+}
+
+static int drive_filename(char *name, char *type, char *mode){ // The file name without the drive number and ",type,mode". Returns the length.
+	char raw[256];
+	int n = 0;
+	drive_raw_name(raw);
+	char *p = raw;
+	if(*p == '@') p++;			// Save with replace, always done
+	char *colon = strchr(p, ':');
+	if(colon && colon - p <= 1) p = colon + 1;	// "0:"
+	*type = *mode = 0;
+	char *comma = strchr(p, ',');
+	if(comma){
+		*comma = 0;
+		*type = toupper(comma[1]);
+		comma = strchr(comma + 1, ',');
+		if(comma) *mode = toupper(comma[1]);
+	}
+	if(*type == 'R' || *type == 'W'){ *mode = *type; *type = 0; } // "name,w"
+	while(p[n]) name[n] = p[n], n++;
+	name[n] = 0;
+	return n;
+}
+
+static int drive_match(const char *pattern, const char *name){ // C64 wildcards: * matches the rest, ? any char. Case is ignored.
+	for( ; *pattern ; pattern++, name++){
+		if(*pattern == '*') return 1;
+		if(!*name || (*pattern != '?' && tolower(*pattern) != tolower(*name))) return 0;
+	}
+	return !*name;
+}
+
+static int drive_is_file(const struct dirent *e){ return e->d_name[0] != '.'; }
+
+static const char *drive_ext(const char *name){ // ".prg" or ".seq" at the end, or NULL
+	size_t len = strlen(name);
+	if(len > 4 && (!strcasecmp(name + len - 4, ".prg") || !strcasecmp(name + len - 4, ".seq"))) return name + len - 4;
+	return NULL;
+}
+
+static int drive_find(const char *pattern, char *path, size_t size){ // The first file (in name order) that matches, with or without .prg/.seq. Returns 0 if none.
+	struct dirent **list;
+	int count = scandir(drive_dir, &list, drive_is_file, alphasort), found = 0;
+	for(int i = 0 ; i < count ; i++){
+		char base[256];
+		snprintf(base, sizeof(base), "%s", list[i]->d_name);
+		const char *ext = drive_ext(base);
+		if(ext) base[ext - base] = 0;
+		if(!found && (drive_match(pattern, list[i]->d_name) || drive_match(pattern, base))){
+			snprintf(path, size, "%s/%s", drive_dir, list[i]->d_name);
+			struct stat st;
+			found = !stat(path, &st) && S_ISREG(st.st_mode);
+		}
+		free(list[i]);
+	}
+	if(count >= 0) free(list);
+	return found;
+}
+
+static uint8_t *drive_listing(size_t *len){ // The "$" file, a BASIC program with the files, like the 1541 makes it. NULL if there is no memory.
+	struct dirent **list;
+	int scanned = scandir(drive_dir, &list, drive_is_file, alphasort), count = scanned < 0 ? 0 : scanned, used = 0;
+	uint8_t *out = malloc(48 * (count + 2) + 2);
+	if(!out){
+		for(int i = 0 ; i < count ; i++) free(list[i]);
+		if(scanned >= 0) free(list);
+		return NULL;
+	}
+	size_t n = 0;
+	out[n++] = 0x01; out[n++] = 0x08;
+	for(int i = -1 ; i <= count ; i++){
+		char text[40];
+		int blocks = 0;
+		if(i < 0) snprintf(text, sizeof(text), "\x12\"%-16.16s\" 00 2A", "HOST DIR");
+		else if(i == count){ blocks = used < DRIVE_BLOCKS ? DRIVE_BLOCKS - used : 0; snprintf(text, sizeof(text), "BLOCKS FREE."); }
+		else{
+			char path[1024], base[256], name[24];
+			struct stat st;
+			snprintf(path, sizeof(path), "%s/%s", drive_dir, list[i]->d_name);
+			snprintf(base, sizeof(base), "%s", list[i]->d_name);
+			free(list[i]);
+			if(stat(path, &st) || !S_ISREG(st.st_mode)) continue;
+			const char *ext = drive_ext(base);
+			const char *type = ext && !strcasecmp(ext, ".seq") ? "SEQ" : "PRG";
+			if(ext) base[ext - base] = 0;
+			snprintf(name, sizeof(name), "\"%.16s\"", base);
+			blocks = (st.st_size + 253) / 254;
+			used += blocks;
+			snprintf(text, sizeof(text), "%*s%-18s %s", blocks < 10 ? 3 : blocks < 100 ? 2 : 1, "", name, type);
+		}
+		for(char *c = text ; *c ; c++) *c = toupper(*c); // Unshifted PETSCII letters
+		size_t line = n;
+		out[n++] = 1; out[n++] = 1; // Link, set below
+		out[n++] = blocks & 0xFF; out[n++] = blocks >> 8;
+		memcpy(&out[n], text, strlen(text));
+		n += strlen(text);
+		out[n++] = 0;
+		uint16_t next = 0x0801 + n - 2;
+		out[line] = next & 0xFF; out[line + 1] = next >> 8;
+	}
+	if(scanned >= 0) free(list);
+	out[n++] = 0; out[n++] = 0;
+	*len = n;
+	return out;
+}
+
+static int drive_map(drive_channel *ch, const char *pattern){ // Open a file to read. Returns 0 if not found (or there is no memory for it).
+	char path[1024];
+	if(!strcmp(pattern, "$")){
+		ch->data = drive_d64 ? d64_listing(&ch->len) : drive_listing(&ch->len);
+		ch->mapped = 0;
+		if(!ch->data) ch->len = 0;
+		return ch->data != NULL;
+	}
+	if(drive_d64){ // The sector chain into a buffer
+		d64_file *f = d64_find(pattern);
+		if(!f) return 0;
+		ch->data = malloc(f->blocks * D64_DATA + 1);
+		if(!ch->data) return 0;
+		ch->len = d64_read(f, 0, ch->data, f->blocks * D64_DATA);
+		ch->mapped = 0;
+		return 1;
+	}
+	if(!drive_find(pattern, path, sizeof(path))) return 0;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return 0;
+	struct stat st;
+	fstat(fd, &st);
+	ch->len = st.st_size;
+	ch->data = ch->len ? mmap(NULL, ch->len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+	if(ch->data == MAP_FAILED){ ch->data = NULL; return 0; }
+	ch->mapped = 1;
+	return 1;
+}
+
+static void drive_unmap(drive_channel *ch){
+	if(ch->data){
+		if(ch->mapped) munmap(ch->data, ch->len);
+		else	       free(ch->data);
+	}
+	if(ch->out) fclose(ch->out);
+	if(ch->mem){
+		int error = d64_write(ch->name, ch->type, (uint8_t*)ch->mem, ch->mem_len);
+		if(error) drive_set_error(error, "DISK FULL");
+		free(ch->mem);
+	}
+	memset(ch, 0, sizeof(drive_channel));
+}
+
+static int drive_bad_name(const char *name){ // A name that would be a path on the host, not a file in the directory
+	return strchr(name, '/') || !strcmp(name, ".") || !strcmp(name, "..");
+}
+
+static int drive_create(drive_channel *ch, const char *name, char type){ // New file for SAVE or a write channel, PRG files gets .prg and SEQ files .seq if there is no extension. Sets the error channel.
+	drive_set_error(0, " OK");
+	if(drive_d64){
+		snprintf(ch->name, sizeof(ch->name), "%s", name);
+		ch->type = type;
+		ch->out = open_memstream(&ch->mem, &ch->mem_len);
+		if(!ch->out) drive_set_error(26, "WRITE PROTECT ON");
+		return ch->out != NULL;
+	}
+	if(drive_bad_name(name)){ drive_set_error(33, "SYNTAX ERROR"); return 0; }
+	char path[1024];
+	const char *ext = strchr(name, '.') ? "" : type == 'S' ? ".seq" : ".prg";
+	snprintf(path, sizeof(path), "%s/%s%s", drive_dir, name, ext);
+	ch->out = fopen(path, "wb");
+	if(!ch->out) drive_set_error(26, "WRITE PROTECT ON");
+	return ch->out != NULL;
+}
+
+static void drive_do_command(void){ // DOS command from the command channel: S:name (scratch) and R:new=old (rename)
+	char *cmd = drive_command, path[1024], old[1024];
+	drive_command[drive_command_len] = 0;
+	drive_command_len = 0;
+	if(!*cmd) return;
+	for(char *c = cmd ; *c ; c++) *c = *c >= 0x41 && *c <= 0x5A ? *c + 0x20 : *c;
+	char *arg = strchr(cmd, ':');
+	arg = arg ? arg + 1 : cmd + 1;
+	if(cmd[0] == 's'){
+		int n = 0;
+		if(drive_d64) n = d64_scratch(arg);
+		else while(drive_find(arg, path, sizeof(path)) && !unlink(path)) n++;
+		snprintf(drive_error, sizeof(drive_error), "01,FILES SCRATCHED,%02d,00\r", n > 99 ? 99 : n);
+		drive_error_pos = 0;
+	}else if(cmd[0] == 'r' && strchr(arg, '=')){
+		char *eq = strchr(arg, '=');
+		*eq = 0;
+		if(drive_d64){
+			int error = d64_rename(arg, eq + 1);
+			drive_set_error(error, error == 62 ? "FILE NOT FOUND" : error ? "FILE EXISTS" : " OK");
+			return;
+		}
+		if(drive_bad_name(arg)){ drive_set_error(33, "SYNTAX ERROR"); return; }
+		if(!drive_find(eq + 1, old, sizeof(old))){ drive_set_error(62, "FILE NOT FOUND"); return; }
+		snprintf(path, sizeof(path), "%s/%s%s", drive_dir, arg, drive_ext(old) && !drive_ext(arg) ? drive_ext(old) : "");
+		if(rename(old, path)) drive_set_error(63, "FILE EXISTS");
+		else		      drive_set_error(0, " OK");
+	}else if(cmd[0] == 'i' || cmd[0] == 'u') drive_set_error(0, " OK");
+	else drive_set_error(31, "SYNTAX ERROR");
+}
+
+static void drive_load_end(uint16_t end){ // LOAD returns the end address in X and Y, and EAL
+	sysram[KERNAL_EAL] = end & 0xFF; sysram[KERNAL_EAL + 1] = end >> 8;
+	x = end & 0xFF;
+	y = end >> 8;
+}
+
+static int drive_load_d64(const char *name){ // Straight from the sector chain to the RAM
+	d64_file *f = d64_find(name);
+	uint8_t address[2];
+	if(!f || d64_read(f, 0, address, 2) < 2) return DRIVE_FILE_NOT_FOUND;
+	uint16_t start = sysram[KERNAL_SA] ? address[0] | (address[1] << 8) : sysram[KERNAL_MEMUSS] | (sysram[KERNAL_MEMUSS + 1] << 8);
+	drive_load_end(start + d64_read(f, 2, &sysram[start], 0x10000 - start));
+	return 0;
+}
+
+static int drive_load(void){
+	char name[256], type, mode;
+	drive_channel ch = {0};
+	sysram[KERNAL_VERIFY] = a; // The trap is before the STA $93 of the KERNAL, the flag is still in A
+	sysram[KERNAL_STATUS] = 0;
+	if(!drive_filename(name, &type, &mode)) return DRIVE_MISSING_FILE_NAME;
+	if(drive_d64 && !sysram[KERNAL_VERIFY] && strcmp(name, "$")) return drive_load_d64(name);
+	if(!drive_map(&ch, name) || ch.len < 2){ drive_unmap(&ch); return DRIVE_FILE_NOT_FOUND; }
+	uint16_t start = sysram[KERNAL_SA] ? ch.data[0] | (ch.data[1] << 8) : sysram[KERNAL_MEMUSS] | (sysram[KERNAL_MEMUSS + 1] << 8); // Secondary address 0 loads to where the KERNAL was told
+	size_t len = ch.len - 2;
+	if(start + len > 0x10000) len = 0x10000 - start;
+	if(sysram[KERNAL_VERIFY]){
+		if(memcmp(&sysram[start], ch.data + 2, len)) sysram[KERNAL_STATUS] |= 0x10; // VERIFY ERROR
+	}else memcpy(&sysram[start], ch.data + 2, len);
+	drive_unmap(&ch);
+	drive_load_end(start + len);
+	return 0;
+}
+
+static int drive_save(void){
+	char name[256], type, mode;
+	if(!drive_filename(name, &type, &mode)) return DRIVE_MISSING_FILE_NAME;
+	uint16_t start = sysram[KERNAL_STAL]   | (sysram[KERNAL_STAL + 1] << 8);
+	uint16_t end   = sysram[KERNAL_EAL]    | (sysram[KERNAL_EAL + 1] << 8);
+	drive_channel ch = {0};
+	sysram[KERNAL_STATUS] = 0;
+	if(!drive_create(&ch, name, 'P')) return DRIVE_DEVICE_NOT_PRESENT;
+	fputc(start & 0xFF, ch.out); fputc(start >> 8, ch.out);
+	for(uint16_t a = start ; a != end ; a++) fputc(read6502(a), ch.out); // Like the KERNAL, what the CPU sees
+	drive_unmap(&ch);
+	return 0;
+}
+
+static int drive_file_index(uint8_t la){ // Index of the logical file in the KERNAL tables, or -1
+	for(int i = 0 ; i < sysram[KERNAL_LDTND] && i < KERNAL_MAX_FILES ; i++) if(sysram[KERNAL_LAT + i] == la) return i;
+	return -1;
+}
+
+static int drive_open(void){
+	char name[256], type, mode;
+	uint8_t la = sysram[KERNAL_LA], sa = sysram[KERNAL_SA] & 0x0F;
+	if(!la) return DRIVE_NOT_INPUT_FILE;
+	if(drive_file_index(la) >= 0) return DRIVE_FILE_OPEN;
+	if(sysram[KERNAL_LDTND] >= KERNAL_MAX_FILES) return DRIVE_TOO_MANY_FILES;
+	int i = sysram[KERNAL_LDTND]++; // In the tables like the KERNAL does it
+	sysram[KERNAL_LAT + i] = la;
+	sysram[KERNAL_FAT + i] = DRIVE_DEVICE;
+	sysram[KERNAL_SAT + i] = sysram[KERNAL_SA] | 0x60;
+	sysram[KERNAL_STATUS] = 0;
+
+	if(sa == 15){ // The name is a command
+		int len = drive_raw_name(name);
+		memcpy(drive_command, name, len < 63 ? len : 63);
+		drive_command_len = len < 63 ? len : 63;
+		drive_do_command();
+		return 0;
+	}
+	int len = drive_filename(name, &type, &mode);
+	drive_channel *ch = &drive_channels[sa];
+	drive_unmap(ch); // A channel left open by CLALL
+	if(!len){ drive_set_error(34, "SYNTAX ERROR"); return 0; }
+	if(mode == 'W' || sa == 1){
+		drive_create(ch, name, type ? type : sa == 1 ? 'P' : 'S');
+	}else if(drive_map(ch, name)) drive_set_error(0, " OK");
+	else drive_set_error(62, "FILE NOT FOUND");
+	return 0; // Like the real drive, errors are in the status and the error channel, not from OPEN
+}
+
+static int drive_close(void){
+	int i = drive_file_index(a);
+	if(i < 0 || sysram[KERNAL_FAT + i] != DRIVE_DEVICE) return DRIVE_ROM;
+	uint8_t sa = sysram[KERNAL_SAT + i] & 0x0F;
+	if(sa == 15) drive_do_command();
+	else	     drive_unmap(&drive_channels[sa]);
+	int last = --sysram[KERNAL_LDTND]; // The last file takes the place
+	sysram[KERNAL_LAT + i] = sysram[KERNAL_LAT + last];
+	sysram[KERNAL_FAT + i] = sysram[KERNAL_FAT + last];
+	sysram[KERNAL_SAT + i] = sysram[KERNAL_SAT + last];
+	return 0;
+}
+
+static int drive_chkio(int out){ // CHKIN (X = logical file) or CHKOUT
+	int i = drive_file_index(x);
+	if(i < 0 || sysram[KERNAL_FAT + i] != DRIVE_DEVICE) return DRIVE_ROM; // The ROM gives FILE NOT OPEN
+	sysram[KERNAL_LA] = sysram[KERNAL_LAT + i];
+	sysram[KERNAL_FA] = DRIVE_DEVICE;
+	sysram[KERNAL_SA] = sysram[KERNAL_SAT + i];
+	if(out){ sysram[KERNAL_DFLTO] = DRIVE_DEVICE; drive_out = sysram[KERNAL_SA] & 0x0F; }
+	else   { sysram[KERNAL_DFLTN] = DRIVE_DEVICE; drive_in  = sysram[KERNAL_SA] & 0x0F; }
+	return 0;
+}
+
+static int drive_chrin(void){ // Also GETIN, they are the same for the serial bus
+	if(sysram[KERNAL_DFLTN] != DRIVE_DEVICE) return DRIVE_ROM;
+	if(sysram[KERNAL_STATUS]){ a = 0x0D; return 0; } // Like the KERNAL, after EOF or a error
+	if(drive_in == 15){
+		a = drive_error[drive_error_pos++];
+		if(!drive_error[drive_error_pos]){ sysram[KERNAL_STATUS] |= 0x40; drive_set_error(0, " OK"); }
+	}else{
+		drive_channel *ch = &drive_channels[drive_in];
+		if(ch->pos >= ch->len){ a = 0x0D; sysram[KERNAL_STATUS] |= 0x42; return 0; } // Nothing to read, or not found
+		a = ch->data[ch->pos++];
+		if(ch->pos == ch->len) sysram[KERNAL_STATUS] |= 0x40; // EOF with the last byte
+	}
+	zerocalc(a);
+	signcalc(a);
+	return 0;
+}
+
+static int drive_chrout(void){
+	if(sysram[KERNAL_DFLTO] != DRIVE_DEVICE) return DRIVE_ROM;
+	if(drive_out == 15){
+		if(a == 0x0D) drive_do_command();
+		else if(drive_command_len < 63) drive_command[drive_command_len++] = a;
+	}else if(drive_channels[drive_out].out) fputc(a, drive_channels[drive_out].out);
+	return 0;
+}
+
+static int drive_clrchn(void){ // Drive 8 needs no UNLISTEN or UNTALK, the ROM does the rest
+	if(sysram[KERNAL_DFLTO] == DRIVE_DEVICE) sysram[KERNAL_DFLTO] = 3;
+	if(sysram[KERNAL_DFLTN] == DRIVE_DEVICE) sysram[KERNAL_DFLTN] = 0;
+	return DRIVE_ROM;
+}
+
+static void drive_trap(void){
+	if(pla_read[pc >> 8] != &kernal[(pc - 0xE000) & 0xFF00]) return; // RAM or a cart, the KERNAL is not there
+	int result;
+	switch(pc){
+		case TRAP_LOAD:		result = sysram[KERNAL_FA] == DRIVE_DEVICE ? drive_load() : DRIVE_ROM; break;
+		case TRAP_SAVE:		result = sysram[KERNAL_FA] == DRIVE_DEVICE ? drive_save() : DRIVE_ROM; break;
+		case TRAP_OPEN:		result = sysram[KERNAL_FA] == DRIVE_DEVICE ? drive_open() : DRIVE_ROM; break;
+		case TRAP_CLOSE:	result = drive_close();		break;
+		case TRAP_CHKIN:	result = drive_chkio(0);	break;
+		case TRAP_CHKOUT:	result = drive_chkio(1);	break;
+		case TRAP_CHRIN:
+		case TRAP_GETIN:	result = drive_chrin();		break;
+		case TRAP_CHROUT:	result = drive_chrout();	break;
+		case TRAP_CLRCHN:	result = drive_clrchn();	break;
+		default: return;
+	}
+	if(result == DRIVE_ROM) return;
+	if(result){ pc = KERNAL_ERROR + 3 * result; return; } // The KERNAL prints the error and returns with carry set
+	pc = pull16() + 1; // RTS
+	clearcarry();
+	clockticks6502 += 6;
+}
+
+/// Make dir (a host directory or a .d64 image) the disk in drive 8. Returns 0 if it's neither.
+int drive_init(const char *dir){
+	static const uint16_t traps[] = { TRAP_GETIN, TRAP_CHRIN, TRAP_CHROUT, TRAP_CHKIN, TRAP_CHKOUT, TRAP_CLOSE, TRAP_CLRCHN, TRAP_OPEN, TRAP_LOAD, TRAP_SAVE };
+	struct stat st;
+	if(stat(dir, &st)) return 0;
+	if(!S_ISDIR(st.st_mode) && !(drive_d64 = d64_open(dir))) return 0;
+	drive_dir = dir;
+	for(unsigned i = 0 ; i < sizeof(traps) / sizeof(traps[0]) ; i++) trap_page[traps[i] >> 8] = 1;
+	trap6502 = drive_trap;
+	return 1;
+}
@@ -0,0 +1,110 @@
+// Fast boot for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after snapshot_c.c.
+// The KERNAL RAM test (RAMTAS) writes and reads back 0x55 and 0xAB in every byte from 0x0400 up to the first ROM, about 2 million cycles of the cold start.
+// It's trapped at its entry and done natively, with the same reads and writes where the map is not plain RAM, so the RAM and the pointers comes out the same.
+// The rest of the cold start (IOINIT, CINT, the BASIC init) is a few thousand cycles and runs in the ROM.
+
+#define FASTBOOT_RAMTAS		0xFD50		// KERNAL RAM test and clear
+#define FASTBOOT_MEMTOP_RET	0xFD8F		// RAMTAS calls MEMTOP (0xFE2D) from 0xFD8D, the return address is left on the stack
+#define FASTBOOT_TAPE1		0xB2		// Pointer to the tape buffer
+#define FASTBOOT_STAL		0xC1		// Pointer used by the test
+#define FASTBOOT_MEMSTR		0x0281		// Bottom of memory for the OS
+#define FASTBOOT_MEMSIZ		0x0283		// Top of memory for the OS
+#define FASTBOOT_HIBASE		0x0288		// Page of the screen
+
+// The start of RAMTAS in the original KERNAL, the trap is only taken if it's there (not a patched or other KERNAL).
+static const uint8_t fastboot_ramtas_rom[] = { 0xA9, 0x00, 0xA8, 0x99, 0x02, 0x00, 0x99, 0x00, 0x02, 0x99, 0x00, 0x03, 0xC8, 0xD0, 0xF4 };
+
+static void (*fastboot_next_trap)(void);	// The traps that was there before (drive 8), called for every other address
+static int fastboot_verify;			// Run RAMTAS both ways and compare, then exit
+
+static void fastboot_ramtas(void){ // What RAMTAS does, ends with a RTS
+	memset(&sysram[0x0002], 0, 0x100);	// 0x0002 - 0x0101
+	memset(&sysram[0x0200], 0, 0x200);	// 0x0200 - 0x03FF
+	sysram[FASTBOOT_TAPE1]     = 0x3C;	// Tape buffer at 0x033C
+	sysram[FASTBOOT_TAPE1 + 1] = 0x03;
+	uint32_t address = 0x0400;
+	while(address < 0x10000){
+		if(!(address & 0xFF) && pla_read[address >> 8] == &sysram[address] && pla_write[address >> 8] == &sysram[address]){ // A page of RAM, the test leaves it as it was
+			address += 0x100;
+			continue;
+		}
+		uint8_t old = read6502(address);
+		write6502(address, 0x55);
+		if(read6502(address) != 0x55) break;
+		write6502(address, 0xAB);			// ROL A of 0x55, with the carry set by the CMP
+		if(read6502(address) != 0xAB) break;
+		write6502(address, old);
+		address++;
+	}
+	x = address & 0xFF;					// TYA TAX LDY STAL+1, then MEMTOP sets the top at the first byte that is not RAM
+	y = (address >> 8) & 0xFF;
+	sysram[FASTBOOT_STAL + 1]   = y;
+	sysram[FASTBOOT_MEMSIZ]     = x;
+	sysram[FASTBOOT_MEMSIZ + 1] = y;
+	sysram[FASTBOOT_MEMSTR + 1] = 0x08;			// Bottom of memory at 0x0800
+	sysram[FASTBOOT_HIBASE]     = 0x04;			// Screen at 0x0400
+	a = 0x04;
+	cpustatus &= ~(FLAG_CARRY | FLAG_ZERO | FLAG_SIGN);
+	push16(FASTBOOT_MEMTOP_RET);				// The JSR MEMTOP leaves its return address under the stack pointer
+	sp += 2;
+	pc = pull16() + 1;					// RTS
+	clockticks6502 += 6;
+}
+
+static void fastboot_ramtas_rom_run(void){ // Run RAMTAS in the ROM until it returns
+	uint8_t  return_sp = sp + 2;
+	uint16_t return_pc = (sysram[0x100 + (uint8_t)(sp + 1)] | (sysram[0x100 + return_sp] << 8)) + 1;
+	while(pc != return_pc || sp != return_sp){
+		exec6502();
+		if(int_pending) interrupt6502();
+		if(clockticks6502 >= sched_next) sched_run(clockticks6502);
+	}
+}
+
+static int fastboot_compare(const char *what, const uint8_t *rom, const uint8_t *native, int len, int base){
+	int differs = 0;
+	for(int i = 0 ; i < len ; i++){
+		if(rom[i] == native[i]) continue;
+		if(differs++ < 8) printf("Fast boot: %s 0x%04X is 0x%02X in the ROM and 0x%02X fast\n", what, base + i, rom[i], native[i]);
+	}
+	return differs;
+}
+
+static void fastboot_verify_ramtas(void){ // Run RAMTAS in the ROM and natively from the same state, compare the RAM and the CPU, and exit. The chips has run longer in the ROM, they are not compared.
+	static snapshot_state before, rom, native;
+	snapshot_take(&before);
+	fastboot_ramtas_rom_run();
+	snapshot_take(&rom);
+	snapshot_restore(&before);
+	fastboot_ramtas();
+	snapshot_take(&native);
+	int differs = fastboot_compare("RAM", rom.sysram, native.sysram, sizeof(rom.sysram), 0)
+		    + fastboot_compare("color RAM", rom.color_ram, native.color_ram, sizeof(rom.color_ram), 0xD800);
+	const snapshot_machine *r = &rom.machine, *n = &native.machine;
+	if(r->pc != n->pc || r->sp != n->sp || r->a != n->a || r->x != n->x || r->y != n->y || r->cpustatus != n->cpustatus){
+		printf("Fast boot: the ROM returns PC=%04X SP=%02X A=%02X X=%02X Y=%02X P=%02X, fast PC=%04X SP=%02X A=%02X X=%02X Y=%02X P=%02X\n",
+			r->pc, r->sp, r->a, r->x, r->y, r->cpustatus, n->pc, n->sp, n->a, n->x, n->y, n->cpustatus);
+		differs++;
+	}
+	if(differs){ printf("Fast boot: %d differences\n", differs); exit(1); }
+	printf("Fast boot: RAMTAS gives the same RAM and registers, %llu cycles in the ROM\n", (unsigned long long)(r->clockticks - before.machine.clockticks));
+	exit(0);
+}
+
+static void fastboot_trap(void){
+	const uint8_t *page = pla_read[pc >> 8];
+	if(pc == FASTBOOT_RAMTAS && page == &kernal[pc - 0xE000 - (pc & 0xFF)] && !memcmp(page + (pc & 0xFF), fastboot_ramtas_rom, sizeof(fastboot_ramtas_rom))){
+		if(fastboot_verify)	fastboot_verify_ramtas();
+		else			fastboot_ramtas();
+		return;
+	}
+	if(fastboot_next_trap) fastboot_next_trap();
+}
+
+/// Trap RAMTAS at every reset. Call after drive_init(), the traps of the drive are kept. verify = run it both ways on the first reset, compare and exit.
+void fastboot_init(int verify){
+	fastboot_verify    = verify;
+	fastboot_next_trap = trap6502;
+	trap_page[FASTBOOT_RAMTAS >> 8] = 1;
+	trap6502 = fastboot_trap;
+}
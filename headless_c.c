@@ -0,0 +1,30 @@
+// Headless host for the C64 BASIC emulator, for servers with no display. Is included by C64_BASIC_EMU.c, last, when C64_HEADLESS is defined.
+// There is no window (ikigui_headless.h), the text on stdin is typed like a paste and the emulation doesn't wait for the real time.
+// It ends when stdin is at its end, everything is typed and BASIC is READY, or at the cycle limit, and prints the text on the screen.
+// The frames can be written raw to a file.
+
+static FILE    *headless_frames;			// --frames, every frame as raw ARGB
+static uint64_t headless_until = UINT64_MAX;		// --cycles, the limit
+static int      headless_screen = 1;			// Print the screen at the end...
+static int      headless_colors;			// ...with the colors
+
+/// Write every frame to name, as display_w * display_h ARGB pixels. Returns 0 if it can't be written.
+int headless_frames_open(const char *name){ return (headless_frames = fopen(name, "wb")) != NULL; }
+
+/// After every frame.
+void headless_frame(void){
+	if(headless_frames && fwrite(display_frame, sizeof(uint32_t), display_w * display_h, headless_frames) != (size_t)(display_w * display_h)){
+		printf("Can't write the frames\n");
+		exit(1);
+	}
+}
+
+/// In every host slice, after the input is taken. Exits with 0 when there is nothing more to do, or with 2 at the cycle limit.
+void headless_slice(void){
+	int ready = !screen_waiting && mywin.stdin_end && !mywin.clipboard && sched_when(paste_event) == SCHED_NEVER && sched_when(prg_event) == SCHED_NEVER
+		 && !sysram[PASTE_KEYBUF_COUNT] && editor_waiting();	// All is typed, and BASIC waits for more
+	if(!ready && clockticks6502 < headless_until) return;
+	if(headless_frames) fclose(headless_frames);
+	if(headless_screen) screen_print(headless_colors);
+	exit(ready ? 0 : 2);
+}
@@ -21,6 +21,22 @@ typedef struct {
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h> // memcpy() for opaque row copies
+
+// SIMD selection. SSE2 is the x86-64 baseline, AVX2 is picked at runtime if the CPU has it. NEON for ARM targets. Define IKIGUI_NO_SIMD to get plain C (e.g. for small MCU:s).
+#ifndef IKIGUI_NO_SIMD
+	#if defined(__SSE2__) || defined(_M_X64)
+		#define IKIGUI_SSE2
+		#include <emmintrin.h>
+		#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+			#define IKIGUI_AVX2 // Compiled with target attributes, so no -mavx2 is needed. Only used if the CPU reports AVX2.
+			#include <immintrin.h>
+		#endif
+	#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#define IKIGUI_NEON
+		#include <arm_neon.h>
+	#endif
+#endif
 
 #ifdef IKIGUI_STANDALONE
 	#include <stdio.h>
@@ -36,7 +52,7 @@ typedef struct {
 #endif
 
 #ifdef IKIGUI_DRAW_ONLY // that declaration excludes all platform specific code, so it can be used for drawing into pixelbuffers only.
-	void map_ikigui_to_sdl(ikigui_image * dest, Uint32 * pixels, int w , int h){ // One helper function that makes it easy to use with lib SDL
+	void map_ikigui_to_sdl(ikigui_image * dest, uint32_t * pixels, int w , int h){ // One helper function that makes it easy to use with lib SDL
 		dest->w = w;
 		dest->h = h;
 		dest->pixels = pixels; // copy pointer
@@ -60,22 +76,174 @@ typedef uint32_t ikigui_color;
 uint32_t ikigui_color_make(uint8_t a, uint8_t r, uint8_t g, uint8_t b){ return (a << 24) + (r << 16) + (g << 8) + (b << 0) ;}
 
 /// Mix 2 colors in ARGB format and return the new color
-unsigned int alpha_channel(unsigned int color_bg,unsigned int color_fg){ // Internal for usage in other functions (done with fixed point math).	uint8_t a1 = (color_bot & 0xff000000)>>24;// alpha color_bot
-	unsigned char alpha = color_fg >> 24;		// Alpha channel
-	unsigned char alpha_inv = ~alpha;		// ~alpha;
-	unsigned char af = (color_fg & 0xff000000)>>24;
-	unsigned char rf = (color_fg & 0xff0000)>>16;	// Red forground
-	unsigned char gf = (color_fg & 0xff00)>>8;	// Green forground
-	unsigned char bf =  color_fg & 0xff;		// Blue forground
-	unsigned char ab = (color_bg & 0xff000000)>>24;
-	unsigned char rb = (color_bg & 0xff0000)>>16;	// Red beckground
-	unsigned char gb = (color_bg & 0xff00)>>8;	// Red background
-	unsigned char bb =  color_bg & 0xff;		// Blue background                
-	unsigned char ro = (alpha_inv * rb + alpha * rf)>>8;   // background + forground
-	unsigned char go = (alpha_inv * gb + alpha * gf)>>8;   // background + forground
-	unsigned char bo = (alpha_inv * bb + alpha * bf)>>8;   // background + forground
-	unsigned char ao = ((uint16_t)(alpha_inv*ab + alpha*af))>>8;   // background + forground
-	return (unsigned int)((ao << 24)+(ro << 16) + (go<< 8) + bo); 
+unsigned int alpha_channel(unsigned int color_bg,unsigned int color_fg){ // Internal for usage in other functions (done with fixed point math).
+	// Two channels at a time in one 32 bit word (R+B and A+G). Each channel sum is at most 255*255, so it never spills into the next 16 bit field.
+	uint32_t alpha     = color_fg >> 24;		// Alpha channel
+	uint32_t alpha_inv = 255 - alpha;		// ~alpha;
+	uint32_t rb = (((color_bg & 0x00FF00FF) * alpha_inv + (color_fg & 0x00FF00FF) * alpha) >> 8) & 0x00FF00FF; // Red and blue, background + forground
+	uint32_t ag =  (((color_bg >> 8) & 0x00FF00FF) * alpha_inv + ((color_fg >> 8) & 0x00FF00FF) * alpha)       & 0xFF00FF00; // Alpha and green, background + forground
+	return (unsigned int)(ag | rb);
+}
+
+// ----------------------------------------------------------
+//   Span kernels - The inner loops of the blit and blend functions, one row (span) at a time
+
+#ifdef IKIGUI_SSE2
+static inline __m128i ikigui_blend4_sse2(__m128i bg, __m128i fg){ // 4 pixels of alpha_channel(), bit exact with the C version.
+	__m128i zero  = _mm_setzero_si128();
+	__m128i ff    = _mm_set1_epi16(0xFF);
+	__m128i fg_lo = _mm_unpacklo_epi8(fg, zero); // 2 pixels as 16 bit channels (B,G,R,A)
+	__m128i fg_hi = _mm_unpackhi_epi8(fg, zero);
+	__m128i bg_lo = _mm_unpacklo_epi8(bg, zero);
+	__m128i bg_hi = _mm_unpackhi_epi8(bg, zero);
+	__m128i a_lo  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fg_lo, 0xFF), 0xFF); // Alpha copied to all 4 channels of the pixel
+	__m128i a_hi  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fg_hi, 0xFF), 0xFF);
+	__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(bg_lo, _mm_xor_si128(a_lo, ff)), _mm_mullo_epi16(fg_lo, a_lo)), 8);
+	__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(bg_hi, _mm_xor_si128(a_hi, ff)), _mm_mullo_epi16(fg_hi, a_hi)), 8);
+	return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+#ifdef IKIGUI_AVX2
+__attribute__((target("avx2"))) static void ikigui_span_blend_avx2(unsigned int *dst, const unsigned int *src, int n){
+	__m256i zero = _mm256_setzero_si256();
+	__m256i ff   = _mm256_set1_epi16(0xFF);
+	int i = 0;
+	for( ; i + 8 <= n ; i += 8){ // 8 pixels per round
+		__m256i fg = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i bg = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i fg_lo = _mm256_unpacklo_epi8(fg, zero);
+		__m256i fg_hi = _mm256_unpackhi_epi8(fg, zero);
+		__m256i bg_lo = _mm256_unpacklo_epi8(bg, zero);
+		__m256i bg_hi = _mm256_unpackhi_epi8(bg, zero);
+		__m256i a_lo  = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(fg_lo, 0xFF), 0xFF);
+		__m256i a_hi  = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(fg_hi, 0xFF), 0xFF);
+		__m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(bg_lo, _mm256_xor_si256(a_lo, ff)), _mm256_mullo_epi16(fg_lo, a_lo)), 8);
+		__m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(bg_hi, _mm256_xor_si256(a_hi, ff)), _mm256_mullo_epi16(fg_hi, a_hi)), 8);
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi)); // unpack/pack stays inside each 128 bit lane, so the pixel order is kept
+	}
+	for( ; i < n ; i++) dst[i] = alpha_channel(dst[i], src[i]); // the rest
+}
+__attribute__((target("avx2"))) static void ikigui_span_fill_avx2(unsigned int *dst, unsigned int color, int n){
+	__m256i c = _mm256_set1_epi32((int)color);
+	int i = 0;
+	for( ; i + 8 <= n ; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), c);
+	for( ; i < n ; i++) dst[i] = color;
+}
+static int ikigui_has_avx2 = -1; // -1 = not tested yet
+static inline int ikigui_use_avx2(void){
+	if(ikigui_has_avx2 < 0) ikigui_has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	return ikigui_has_avx2;
+}
+#endif
+
+#ifdef IKIGUI_NEON
+static inline uint8x16_t ikigui_blend4_neon(uint8x16_t bg, uint8x16_t fg){ // 4 pixels of alpha_channel(), bit exact with the C version.
+	uint8x16_t a  = vreinterpretq_u8_u32(vmulq_n_u32(vshrq_n_u32(vreinterpretq_u32_u8(fg), 24), 0x01010101)); // Alpha copied to all 4 bytes of the pixel
+	uint8x16_t ia = vmvnq_u8(a);
+	uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(bg),  vget_low_u8(ia)),  vmull_u8(vget_low_u8(fg),  vget_low_u8(a)));
+	uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(bg), vget_high_u8(ia)), vmull_u8(vget_high_u8(fg), vget_high_u8(a)));
+	return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+#endif
+
+/// Blend a span of n source pixels over the destination pixels, same as alpha_channel() for every pixel.
+void ikigui_span_blend(unsigned int *dst, const unsigned int *src, int n){
+	int i = 0;
+#if defined(IKIGUI_AVX2)
+	if(ikigui_use_avx2()){ ikigui_span_blend_avx2(dst, src, n); return; }
+#endif
+#if defined(IKIGUI_SSE2)
+	for( ; i + 4 <= n ; i += 4){
+		__m128i fg = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i bg = _mm_loadu_si128((const __m128i*)(dst + i));
+		_mm_storeu_si128((__m128i*)(dst + i), ikigui_blend4_sse2(bg, fg));
+	}
+#elif defined(IKIGUI_NEON)
+	for( ; i + 4 <= n ; i += 4){
+		uint8x16_t fg = vreinterpretq_u8_u32(vld1q_u32((const uint32_t*)(src + i)));
+		uint8x16_t bg = vreinterpretq_u8_u32(vld1q_u32((const uint32_t*)(dst + i)));
+		vst1q_u32((uint32_t*)(dst + i), vreinterpretq_u32_u8(ikigui_blend4_neon(bg, fg)));
+	}
+#endif
+	for( ; i < n ; i++) dst[i] = alpha_channel(dst[i], src[i]); // the rest, or everything without SIMD
+}
+
+#ifndef IKIGUI_STREAM_BYTES
+	#define IKIGUI_STREAM_BYTES (1024*1024) // Fills larger than this bypass the cache with streaming stores.
+#endif
+/// Fill a span of n pixels with one ARGB value (no alpha blending).
+void ikigui_span_fill(unsigned int *dst, unsigned int color, int n){
+	int i = 0;
+#if defined(IKIGUI_SSE2)
+	if((size_t)n * 4 >= IKIGUI_STREAM_BYTES){ // Large fill, use non temporal stores so we don't throw out everything else from the cache.
+		__m128i c = _mm_set1_epi32((int)color);
+		for( ; i < n && ((uintptr_t)(dst + i) & 15) ; i++) dst[i] = color; // align to 16 bytes
+		for( ; i + 4 <= n ; i += 4) _mm_stream_si128((__m128i*)(dst + i), c);
+		_mm_sfence();
+	}
+	#if defined(IKIGUI_AVX2)
+	else if(ikigui_use_avx2()){ ikigui_span_fill_avx2(dst, color, n); return; }
+	#endif
+	else{
+		__m128i c = _mm_set1_epi32((int)color);
+		for( ; i + 4 <= n ; i += 4) _mm_storeu_si128((__m128i*)(dst + i), c);
+	}
+#elif defined(IKIGUI_NEON)
+	uint32x4_t c = vdupq_n_u32(color);
+	for( ; i + 4 <= n ; i += 4) vst1q_u32((uint32_t*)(dst + i), c);
+#endif
+	for( ; i < n ; i++) dst[i] = color; // the rest, or everything without SIMD
+}
+/// Copy a span of n opaque pixels.
+void ikigui_span_copy(unsigned int *dst, const unsigned int *src, int n){
+	memcpy(dst, src, (size_t)n * sizeof(unsigned int)); // libc picks vector and streaming stores by itself
+}
+/// Nearest neighbour upscale of n pixels, every source pixel is written factor times (n * factor pixels in dst).
+void ikigui_span_scale(unsigned int *dst, const unsigned int *src, int n, int factor){
+	int i = 0;
+#if defined(IKIGUI_SSE2)
+	if(factor == 2){
+		for( ; i + 4 <= n ; i += 4, dst += 8){
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)dst,       _mm_unpacklo_epi32(v, v));
+			_mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi32(v, v));
+		}
+	}else if(factor == 3){
+		for( ; i + 4 <= n ; i += 4, dst += 12){ // abcd -> aaab bbcc cddd
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)dst,       _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,0,0)));
+			_mm_storeu_si128((__m128i*)(dst + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2,2,1,1)));
+			_mm_storeu_si128((__m128i*)(dst + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3,3,3,2)));
+		}
+	}else if(factor == 4){
+		for( ; i + 4 <= n ; i += 4, dst += 16){
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)dst,        _mm_shuffle_epi32(v, 0x00));
+			_mm_storeu_si128((__m128i*)(dst + 4),  _mm_shuffle_epi32(v, 0x55));
+			_mm_storeu_si128((__m128i*)(dst + 8),  _mm_shuffle_epi32(v, 0xAA));
+			_mm_storeu_si128((__m128i*)(dst + 12), _mm_shuffle_epi32(v, 0xFF));
+		}
+	}
+#elif defined(IKIGUI_NEON)
+	if(factor == 2){
+		for( ; i + 4 <= n ; i += 4, dst += 8){
+			uint32x4_t v = vld1q_u32((const uint32_t*)(src + i));
+			uint32x4x2_t z = vzipq_u32(v, v);
+			vst1q_u32((uint32_t*)dst, z.val[0]);
+			vst1q_u32((uint32_t*)(dst + 4), z.val[1]);
+		}
+	}else if(factor == 4){
+		for( ; i + 4 <= n ; i += 4, dst += 16){
+			uint32x4_t v = vld1q_u32((const uint32_t*)(src + i));
+			vst1q_u32((uint32_t*)dst,        vdupq_n_u32(vgetq_lane_u32(v, 0)));
+			vst1q_u32((uint32_t*)(dst + 4),  vdupq_n_u32(vgetq_lane_u32(v, 1)));
+			vst1q_u32((uint32_t*)(dst + 8),  vdupq_n_u32(vgetq_lane_u32(v, 2)));
+			vst1q_u32((uint32_t*)(dst + 12), vdupq_n_u32(vgetq_lane_u32(v, 3)));
+		}
+	}
+#endif
+	for( ; i < n ; i++) for(int f = 0 ; f < factor ; f++) *dst++ = src[i]; // the rest, other factors, or everything without SIMD
 }
 
 /// Get pixel ARGB value
@@ -100,11 +268,14 @@ void ikigui_draw_image(ikigui_image *dest,ikigui_image *source, int x, int y){
 	int inter_h = source->h ;
 	if(dest->w < (source->w + x)) inter_w = dest->w - (x) ; // clip off right  part of image and block crash
 	if(dest->h < (source->h + y)) inter_h = dest->h - (y) ; // clip off bottom part of image and block crash
+	if(inter_w <= 0 || inter_h <= 0) return;
 
+	if(x == 0 && inter_w == dest->w && dest->w == source->w){ // Same width, the whole thing is one block in memory
+		ikigui_span_copy(&dest->pixels[y*dest->w], source->pixels, inter_w * inter_h);
+		return;
+	}
         for(int j = 0 ; j < inter_h ; j++){ // vertical
-		for(int i = 0 ; i < inter_w ; i++){   // horizontal
-                        dest->pixels[x+i+(j+y)*dest->w] = source->pixels[i+source->w*j];
-                }
+		ikigui_span_copy(&dest->pixels[x+(j+y)*dest->w], &source->pixels[source->w*j], inter_w); // horizontal
         }
 }
 /// Draw area. Flexible to Blit in windows and pixel buffers.
@@ -113,11 +284,10 @@ void ikigui_draw_image_composite(ikigui_image *dest,ikigui_image *source, int x,
 	int inter_h = source->h ;
 	if(dest->w < (source->w + x)) inter_w = dest->w - (x) ; // clip off right  part of image and block crash
 	if(dest->h < (source->h + y)) inter_h = dest->h - (y) ; // clip off bottom part of image and block crash
+	if(inter_w <= 0 || inter_h <= 0) return;
 
 	for(int j = 0 ; j < inter_h ; j++){ // vertical
-                for(int i = 0 ; i < inter_w ; i++){   // horizontal         
-                        dest->pixels[x+i+(j+y)*dest->w] = alpha_channel(dest->pixels[x+i+(j+y)*dest->w],source->pixels[i+source->w*j]);
-                }
+		ikigui_span_blend(&dest->pixels[x+(j+y)*dest->w], &source->pixels[source->w*j], inter_w); // horizontal
         }
 }
 
@@ -131,9 +301,7 @@ void ikigui_tile_alpha(ikigui_image *dest,ikigui_image *source, int x, int y, ik
         if(dest->w < (x+part->w))return; // shelding crash
         if(dest->h < (y+part->h))return; // shelding crash
         for(int j = 0 ; j < part->h ; j++){ // vertical
-                for(int i = 0 ; i < part->w ; i++){   // horizontal
-                        dest->pixels[x+i+(j+y)*dest->w] = alpha_channel(dest->pixels[x+i+(j+y)*dest->w],source->pixels[i+part->x+source->w*(j+part->y)]);
-                }
+		ikigui_span_blend(&dest->pixels[x+(j+y)*dest->w], &source->pixels[part->x+source->w*(j+part->y)], part->w); // horizontal
         }
 }
 /// Draw area - can be used if you whant to fill low alpha value with a solid color.
@@ -167,9 +335,7 @@ void ikigui_tile_fast(ikigui_image *dest,ikigui_image *source, int x, int y, iki
         if(dest->w < (x+part->w))return; // shelding crash
         if(dest->h < (y+part->h))return; // shelding crash
         for(int j = 0 ; j < part->h ; j++){ // vertical
-                for(int i = 0 ; i < part->w ; i++){   // horizontal
-                        dest->pixels[x+i+(j+y)*dest->w] = source->pixels[i+part->x+source->w*(j+part->y)];
-                }
+		ikigui_span_copy(&dest->pixels[x+(j+y)*dest->w], &source->pixels[part->x+source->w*(j+part->y)], part->w); // horizontal
         }
 }
 
@@ -534,9 +700,7 @@ void ikigui_draw_box_simple(ikigui_image *dest, uint32_t color, ikigui_rect *par
         if(dest->h < (y+part->h))return; // shielding crash
 	if((color & 0xFF000000) == 0xFF000000){ // Do we use alpha? True if no alpha (alpha is set to 0xFF in the color value)
 		for(int j = 0 ; j < part->h ; j++){ // vertical
-		        for(int i = 0 ; i < part->w ; i++){   // horizontal
-				dest->pixels[x+i+(j+y)*dest->w] = color ; // without alpha
-		        }
+			ikigui_span_fill(&dest->pixels[x+(j+y)*dest->w], color, part->w); // without alpha
 		}
 	}else{
 		for(int j = 0 ; j < part->h ; j++){ // vertical
@@ -762,7 +926,7 @@ void ikigui_draw_circle(ikigui_image *dest, uint32_t color, int x0, int y0, unsi
 
 /// Fill image or window with a ARGB value.
 void ikigui_image_solid(ikigui_image *dest, unsigned int color){ 
-        for(int i = 0 ; i < dest->w * dest->h ; i++){	dest->pixels[i] = color; }
+	ikigui_span_fill(dest->pixels, color, dest->w * dest->h);
 }
 /// Fill background in destination. Doesn't overwrite the image.
 void ikigui_image_solid_bg(ikigui_image *dest,unsigned int color){ 
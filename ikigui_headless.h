@@ -0,0 +1,108 @@
+/// @file ikigui_headless.h No platform, for running without a display. What the C64 BASIC emulator uses of ikigui_lin.h, without X11.
+// Use with IKIGUI_DRAW_ONLY. The key queue is the same as in ikigui_lin.h and the key symbols have the X11 numbers, so recorded key events
+// mean the same here. The events come from the program (ikigui_key_push), and the clipboard is the text that comes on stdin.
+
+#include <stdatomic.h>	// The key event queue
+#include <poll.h>	// stdin is read without waiting
+#include <unistd.h>
+
+typedef unsigned long KeySym;
+
+// The X11 key symbols that keyboard_c.c maps
+#define XK_BackSpace	0xFF08
+#define XK_Tab		0xFF09
+#define XK_Return	0xFF0D
+#define XK_Escape	0xFF1B
+#define XK_Home		0xFF50
+#define XK_Left		0xFF51
+#define XK_Up		0xFF52
+#define XK_Right	0xFF53
+#define XK_Down		0xFF54
+#define XK_Prior	0xFF55
+#define XK_Insert	0xFF63
+#define XK_KP_Enter	0xFF8D
+#define XK_F1		0xFFBE
+#define XK_F2		0xFFBF
+#define XK_F3		0xFFC0
+#define XK_F4		0xFFC1
+#define XK_F5		0xFFC2
+#define XK_F6		0xFFC3
+#define XK_F7		0xFFC4
+#define XK_F8		0xFFC5
+#define XK_F9		0xFFC6
+#define XK_F12		0xFFC9
+#define XK_Shift_L	0xFFE1
+#define XK_Shift_R	0xFFE2
+#define XK_Control_L	0xFFE3
+#define XK_Control_R	0xFFE4
+#define XK_Alt_L	0xFFE9
+#define XK_Super_L	0xFFEB
+#define XK_Delete	0xFFFF
+
+typedef struct { // As in ikigui_lin.h
+	uint64_t time_ns;
+	KeySym   keysym;
+	unsigned keycode;
+	unsigned state;
+	char     down;
+	char     repeat;
+} ikigui_key_event;
+
+#define IKIGUI_KEY_QUEUE 256
+typedef struct {
+	ikigui_key_event event[IKIGUI_KEY_QUEUE];
+	_Atomic unsigned head;
+	_Atomic unsigned tail;
+} ikigui_key_queue;
+
+typedef struct {
+	ikigui_key_queue keys;		// Only from a journal replay, there is no keyboard
+	char *clipboard;		// Text that has come on stdin, malloc'ed. Free it and set it to NULL when used.
+	unsigned long clipboard_len;
+	int stdin_end;			// stdin is closed, no more input comes
+} ikigui_window;
+
+static void ikigui_key_push(ikigui_window *mywin, unsigned keycode, KeySym keysym, unsigned state, int down, int repeat){ // Drops the event if the queue is full
+	unsigned tail = atomic_load_explicit(&mywin->keys.tail, memory_order_relaxed);
+	if(tail - atomic_load_explicit(&mywin->keys.head, memory_order_acquire) == IKIGUI_KEY_QUEUE) return;
+	ikigui_key_event *e = &mywin->keys.event[tail & (IKIGUI_KEY_QUEUE - 1)];
+	e->time_ns = 0;
+	e->keycode = keycode;
+	e->keysym  = keysym;
+	e->state   = state;
+	e->down    = down;
+	e->repeat  = repeat;
+	atomic_store_explicit(&mywin->keys.tail, tail + 1, memory_order_release);
+}
+
+int ikigui_key_peek(ikigui_window *mywin, ikigui_key_event *event){
+	unsigned head = atomic_load_explicit(&mywin->keys.head, memory_order_relaxed);
+	if(head == atomic_load_explicit(&mywin->keys.tail, memory_order_acquire)) return 0;
+	*event = mywin->keys.event[head & (IKIGUI_KEY_QUEUE - 1)];
+	return 1;
+}
+
+int ikigui_key_pop(ikigui_window *mywin, ikigui_key_event *event){
+	if(!ikigui_key_peek(mywin, event)) return 0;
+	atomic_fetch_add_explicit(&mywin->keys.head, 1, memory_order_release);
+	return 1;
+}
+
+void ikigui_clipboard_request(ikigui_window *mywin){ (void)mywin; } // There is no clipboard, stdin is pasted
+
+/// Take up to 4K of the text that has come on stdin into mywin->clipboard, without waiting for more.
+void ikigui_window_get_events(ikigui_window *mywin){
+	char buf[4096];
+	struct pollfd fd = { .fd = 0, .events = POLLIN };
+	if(!mywin->stdin_end && poll(&fd, 1, 0) > 0){
+		ssize_t n = read(0, buf, sizeof(buf));
+		if(n <= 0){ mywin->stdin_end = 1; return; }
+		if(!mywin->clipboard) mywin->clipboard_len = 0; // The last text is used
+		char *text = realloc(mywin->clipboard, mywin->clipboard_len + n);
+		if(!text){ printf("Out of memory for stdin\n"); exit(1); }
+		memcpy(text + mywin->clipboard_len, buf, n);
+		mywin->clipboard = text;
+		mywin->clipboard_len += n;
+	}
+}
+
@@ -3,6 +3,15 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xos.h>
+#include <X11/keysym.h>
+#include <stdatomic.h>	// The key event queue
+#include <poll.h>	// ikigui_window_wait_events()
+#include <time.h>	// Time stamps of the key events
+#ifndef IKIGUI_NO_SHM // MIT-SHM for zero copy frame upload, link with -lXext. Define IKIGUI_NO_SHM to build without it.
+	#include <X11/extensions/XShm.h>
+	#include <sys/ipc.h>
+	#include <sys/shm.h>
+#endif
 
 enum { MOUSE_LEFT = 0b1, MOUSE_MIDDLE = 0b10, MOUSE_RIGHT = 0b100, MOUSE_X1 = 0b1000, MOUSE_X2 = 0b10000 };
 
@@ -24,6 +33,24 @@ struct mouse{
 	char right_release; 	// mouse down events 
 } ;
 
+/// A key going down or up, with the time it was read from the X server.
+typedef struct {
+	uint64_t time_ns;	///< CLOCK_MONOTONIC nano seconds
+	KeySym   keysym;	///< The symbol with the modifiers applied (like XK_A or XK_quotedbl), from the press
+	unsigned keycode;	///< The physical key, the same for down and up. 0 with down = 0 means every key is up (the window lost focus).
+	unsigned state;		///< X modifier mask (ShiftMask, ControlMask...)
+	char     down;		///< 1 = pressed, 0 = released
+	char     repeat;	///< A auto repeat press, the key is still held down
+} ikigui_key_event;
+
+#define IKIGUI_KEY_QUEUE 256 ///< Events in the key queue, a power of two
+/// Lock free single producer (ikigui_window_get_events) single consumer queue, so the consumer can be on another thread.
+typedef struct {
+	ikigui_key_event event[IKIGUI_KEY_QUEUE];
+	_Atomic unsigned head;	///< Next to read, only written by the consumer
+	_Atomic unsigned tail;	///< Next to write, only written by the producer
+} ikigui_key_queue;
+
 typedef struct {
         // here are our X variables
         Display *dis;           // X Server connection
@@ -36,6 +63,10 @@ typedef struct {
         // to handle keypress events
 	KeySym key;		/* a dealie-bob to handle KeyPress Events */	
 	char text[255];		/* a char buffer for KeyPress Events */
+	ikigui_key_queue keys;	// Every key down and up, in order
+	unsigned repeat_keycode; // The release of this key was a auto repeat, so the next press of it is too
+	char *clipboard;	// Text from ikigui_clipboard_request() when it has come, malloc'ed. Free it and set it to NULL when used.
+	unsigned long clipboard_len;
 
         // to handle mouse events
         struct mouse mouse;
@@ -45,6 +76,12 @@ typedef struct {
 	Pixmap bitmap;
         ikigui_image image;
 	char name[32];
+#ifndef IKIGUI_NO_SHM
+	XShmSegmentInfo shminfo;	// The shared memory segment that holds image.pixels when use_shm is set
+	int use_shm;			// 1 if the X server reads the pixels directly from our memory
+	int shm_pending;		// 1 while the X server may still read from the last XShmPutImage
+	int shm_completion;		// The event type for ShmCompletion
+#endif
 } ikigui_window;                     
 
 int old_x;
@@ -53,8 +90,75 @@ int old_y;
 /// A helper function that return the pointer to the ikigui_image inside a ikigui_window
 ikigui_image*	ikigui_image_of_window(ikigui_window* window){ return &window->image; }
 
+#ifndef IKIGUI_NO_SHM
+static int ikigui_shm_error; // Set by the error handler if XShmAttach fails (e.g. remote display)
+static int ikigui_shm_error_handler(Display *dis, XErrorEvent *err){ (void)dis; (void)err; ikigui_shm_error = 1; return 0; }
+static Bool ikigui_shm_is_completion(Display *dis, XEvent *ev, XPointer arg){ (void)dis; return ev->type == ((ikigui_window*)arg)->shm_completion; }
+
+static int ikigui_window_shm_make(ikigui_window *mywin, Visual *visual, int depth, int w, int h){ // Returns 1 if the window pixels are in a shared segment
+	mywin->use_shm = 0;
+	mywin->shm_pending = 0;
+	if(!XShmQueryExtension(mywin->dis)) return 0; // No extension, e.g. Xvfb started without it
+	mywin->ximage = XShmCreateImage(mywin->dis, visual, depth, ZPixmap, NULL, &mywin->shminfo, w, h);
+	if(!mywin->ximage) return 0;
+	mywin->shminfo.shmid = shmget(IPC_PRIVATE, mywin->ximage->bytes_per_line * h, IPC_CREAT | 0600);
+	if(mywin->shminfo.shmid < 0){ XDestroyImage(mywin->ximage); mywin->ximage = NULL; return 0; }
+	mywin->shminfo.shmaddr = mywin->ximage->data = (char*)shmat(mywin->shminfo.shmid, 0, 0);
+	if(mywin->shminfo.shmaddr == (char*)-1){
+		shmctl(mywin->shminfo.shmid, IPC_RMID, 0);
+		mywin->ximage->data = NULL; XDestroyImage(mywin->ximage); mywin->ximage = NULL;
+		return 0;
+	}
+	mywin->shminfo.readOnly = False;
+
+	ikigui_shm_error = 0; // XShmAttach fails asynchronously if the server can't reach our memory (not a local display), so sync and look for errors
+	XErrorHandler old_handler = XSetErrorHandler(ikigui_shm_error_handler);
+	XShmAttach(mywin->dis, &mywin->shminfo);
+	XSync(mywin->dis, False);
+	XSetErrorHandler(old_handler);
+	shmctl(mywin->shminfo.shmid, IPC_RMID, 0); // Removed when both sides have detached
+	if(ikigui_shm_error){
+		shmdt(mywin->shminfo.shmaddr);
+		mywin->ximage->data = NULL; XDestroyImage(mywin->ximage); mywin->ximage = NULL;
+		return 0;
+	}
+	mywin->shm_completion = XShmGetEventBase(mywin->dis) + ShmCompletion;
+	mywin->image.pixels = (unsigned int *)mywin->shminfo.shmaddr;
+	mywin->use_shm = 1;
+	return 1;
+}
+#endif
+
+/// Free the pixel buffer and the XImage of the window, and the shared memory segment
+static void ikigui_window_image_free(ikigui_window *mywin){
+	if(!mywin->ximage) return;
+#ifndef IKIGUI_NO_SHM
+	if(mywin->use_shm){
+		XShmDetach(mywin->dis, &mywin->shminfo);
+		XSync(mywin->dis, False);
+		shmdt(mywin->shminfo.shmaddr);
+		mywin->ximage->data = NULL; // Not from malloc()
+		mywin->use_shm = 0;
+		mywin->shm_pending = 0;
+	}
+#endif
+	XDestroyImage(mywin->ximage); // Also frees the pixels from malloc()
+	mywin->ximage = NULL;
+	mywin->image.pixels = NULL;
+}
+
+/// Create the pixel buffer and the XImage for the window, in shared memory if possible
+static void ikigui_window_image_make(ikigui_window *mywin, Visual *visual, int depth, int w, int h){
+#ifndef IKIGUI_NO_SHM
+	if(ikigui_window_shm_make(mywin, visual, depth, w, h)) return;
+#endif
+	mywin->image.pixels = (unsigned int *)malloc(w * h * 4); // Fallback, pixels is sent trough the X socket on every update
+	mywin->ximage = XCreateImage(mywin->dis, visual, depth, ZPixmap, 0, (char*)mywin->image.pixels, w, h, 32, w * 4);
+}
+
 /// Open a child window
 void ikigui_window_open_editor(ikigui_window *mywin,void *ptr,int w, int h){
+	ikigui_window_image_free(mywin); // If it's opened again, on the display it had
         mywin->image.w = w;
         mywin->image.h = h;
 	mywin->dis=XOpenDisplay((char *)0);     // Get the display
@@ -79,9 +183,8 @@ void ikigui_window_open_editor(ikigui_window *mywin,void *ptr,int w, int h){
         XWindowAttributes wa = {0};
         XGetWindowAttributes(mywin->dis, mywin->win, &wa);
 
-	mywin->image.pixels = (unsigned int *)malloc(w * h * 4);
 	mywin->bitmap = XCreatePixmap(mywin->dis, mywin->win, w, h, 1);
-	mywin->ximage = XCreateImage(mywin->dis, wa.visual, wa.depth, ZPixmap, 0, (char*)mywin->image.pixels, w, h, 32, w * 4);
+	ikigui_window_image_make(mywin, wa.visual, wa.depth, w, h);
 
         XReparentWindow(mywin->dis, mywin->win,(Window)ptr, 0, 0);
         XFlush(mywin->dis);
@@ -89,14 +192,93 @@ void ikigui_window_open_editor(ikigui_window *mywin,void *ptr,int w, int h){
 
 
 void ikigui_window_close(ikigui_window *mywin){
+	ikigui_window_image_free(mywin);
 	XDestroyWindow(mywin->dis, mywin->win);
 	XCloseDisplay(mywin->dis);				
 };
+static int ikigui_rect_clip(ikigui_window *mywin, ikigui_rect *r){ // Clip to the window, returns 0 if nothing is left
+	if(r->x < 0){ r->w += r->x; r->x = 0; }
+	if(r->y < 0){ r->h += r->y; r->y = 0; }
+	if(r->x + r->w > mywin->image.w) r->w = mywin->image.w - r->x;
+	if(r->y + r->h > mywin->image.h) r->h = mywin->image.h - r->y;
+	return r->w > 0 && r->h > 0;
+}
+/// Updates parts of the Window graphics with new things drawn, only the damaged rects is uploaded
+void ikigui_window_update_rects(ikigui_window *mywin, ikigui_rect *rects, int count){
+#ifndef IKIGUI_NO_SHM
+	if(mywin->use_shm && mywin->shm_pending){ // The server must be done reading the last frame before we send a new one, unless ikigui_window_get_events() got the completion already
+		XEvent done;
+		XIfEvent(mywin->dis, &done, ikigui_shm_is_completion, (XPointer)mywin);
+		mywin->shm_pending = 0;
+	}
+	int last = -1; // Only ask for a completion event for the last rect that is drawn
+	for(int i = 0 ; mywin->use_shm && i < count ; i++){
+		ikigui_rect r = rects[i];
+		if(ikigui_rect_clip(mywin, &r)) last = i;
+	}
+#endif
+	for(int i = 0 ; i < count ; i++){
+		ikigui_rect r = rects[i];
+		if(!ikigui_rect_clip(mywin, &r)) continue;
+#ifndef IKIGUI_NO_SHM
+		if(mywin->use_shm){
+			XShmPutImage(mywin->dis, mywin->win, mywin->gc, mywin->ximage, r.x, r.y, r.x, r.y, r.w, r.h, i == last);
+			continue;
+		}
+#endif
+		XPutImage(mywin->dis, mywin->win, mywin->gc, mywin->ximage, r.x, r.y, r.x, r.y, r.w, r.h);
+	}
+#ifndef IKIGUI_NO_SHM
+	if(last >= 0) mywin->shm_pending = 1;
+#endif
+	XFlush(mywin->dis);
+}
 /// Updates the Window graphics with new things drawn
 void ikigui_window_update(ikigui_window *mywin){
-        XPutImage(mywin->dis, mywin->win, mywin->gc, mywin->ximage, 0, 0, 0, 0, mywin->image.w, mywin->image.h);
+	ikigui_rect all = {.x = 0, .y = 0, .w = mywin->image.w, .h = mywin->image.h};
+	ikigui_window_update_rects(mywin, &all, 1);
 };
 /// Update the event data for the Window
+static void ikigui_key_push(ikigui_window *mywin, unsigned keycode, KeySym keysym, unsigned state, int down, int repeat){ // Producer side, drops the event if the queue is full
+	unsigned tail = atomic_load_explicit(&mywin->keys.tail, memory_order_relaxed);
+	if(tail - atomic_load_explicit(&mywin->keys.head, memory_order_acquire) == IKIGUI_KEY_QUEUE) return;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ikigui_key_event *e = &mywin->keys.event[tail & (IKIGUI_KEY_QUEUE - 1)];
+	e->time_ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+	e->keycode = keycode;
+	e->keysym  = keysym;
+	e->state   = state;
+	e->down    = down;
+	e->repeat  = repeat;
+	atomic_store_explicit(&mywin->keys.tail, tail + 1, memory_order_release);
+}
+/// Look at the oldest key event without taking it. Returns 0 if there is none.
+int ikigui_key_peek(ikigui_window *mywin, ikigui_key_event *event){
+	unsigned head = atomic_load_explicit(&mywin->keys.head, memory_order_relaxed);
+	if(head == atomic_load_explicit(&mywin->keys.tail, memory_order_acquire)) return 0;
+	*event = mywin->keys.event[head & (IKIGUI_KEY_QUEUE - 1)];
+	return 1;
+}
+/// Take the oldest key event. Returns 0 if there is none.
+int ikigui_key_pop(ikigui_window *mywin, ikigui_key_event *event){
+	if(!ikigui_key_peek(mywin, event)) return 0;
+	atomic_fetch_add_explicit(&mywin->keys.head, 1, memory_order_release);
+	return 1;
+}
+/// Sleep until there are events from the X server, or timeout_ms has passed. Returns 1 if there are events to get.
+int ikigui_window_wait_events(ikigui_window *mywin, int timeout_ms){
+	if(XPending(mywin->dis)) return 1;
+	struct pollfd fd = { .fd = ConnectionNumber(mywin->dis), .events = POLLIN };
+	return poll(&fd, 1, timeout_ms) > 0;
+}
+/// Ask the owner of the clipboard for the text. It comes later, in mywin->clipboard from ikigui_window_get_events().
+void ikigui_clipboard_request(ikigui_window *mywin){
+	Atom clipboard = XInternAtom(mywin->dis, "CLIPBOARD", False), utf8 = XInternAtom(mywin->dis, "UTF8_STRING", False);
+	XConvertSelection(mywin->dis, clipboard, utf8, clipboard, mywin->win, CurrentTime); // The owner puts it in a property on our window
+	XFlush(mywin->dis);
+}
+
 void ikigui_window_get_events(ikigui_window *mywin){
 	// values for recognicing changes in mousemovements and mouse buttons.
 	
@@ -106,6 +288,9 @@ void ikigui_window_get_events(ikigui_window *mywin){
 	
         while( XPending(mywin->dis) > 0 ){ // no of events in que
                 XNextEvent(mywin->dis, &mywin->event); // Get next event
+#ifndef IKIGUI_NO_SHM
+		if(mywin->use_shm && mywin->event.type == mywin->shm_completion) mywin->shm_pending = 0; // The server is done with the last frame, ikigui_window_update_rects() must not wait for it
+#endif
 
                 if (mywin->event.type== ClientMessage){ // User Closes window
                         if ((Atom) mywin->event.xclient.data.l[0] == mywin->wm_delete_window) {
@@ -131,6 +316,9 @@ void ikigui_window_get_events(ikigui_window *mywin){
 			case KeyPress: {
 				// This new one to deal with the emulator is from 20250725 ->
 				int len = XLookupString(&mywin->event.xkey, mywin->text, 255, &mywin->key, 0);
+				int repeat = mywin->repeat_keycode == mywin->event.xkey.keycode;
+				mywin->repeat_keycode = 0;
+				ikigui_key_push(mywin, mywin->event.xkey.keycode, mywin->key, mywin->event.xkey.state, 1, repeat);
 
 				// Ignore modifier keys / Ignore dead keys (like " on some layouts) to avoid duplicates
 				if (mywin->key == XK_Shift_L || mywin->key == XK_Shift_R ||
@@ -164,6 +352,41 @@ void ikigui_window_get_events(ikigui_window *mywin){
 					}
 			end of old */
 			// }
+			break;
+			case KeyRelease: {
+				if(XEventsQueued(mywin->dis, QueuedAfterReading)){ // Auto repeat is a release and a press with the same time, skip the release
+					XEvent next;
+					XPeekEvent(mywin->dis, &next);
+					if(next.type == KeyPress && next.xkey.time == mywin->event.xkey.time && next.xkey.keycode == mywin->event.xkey.keycode){
+						mywin->repeat_keycode = next.xkey.keycode;
+						break;
+					}
+				}
+				KeySym sym;
+				char text[8];
+				XLookupString(&mywin->event.xkey, text, sizeof(text), &sym, 0);
+				ikigui_key_push(mywin, mywin->event.xkey.keycode, sym, mywin->event.xkey.state, 0, 0);
+			}
+			break;
+			case FocusOut: ikigui_key_push(mywin, 0, NoSymbol, 0, 0, 0); break; // The key releases will go to some other window
+			case SelectionNotify: { // The clipboard text is here, or property is None if there was none. Large texts sent with INCR are not supported.
+				Atom type;
+				int format;
+				unsigned long items, after;
+				unsigned char *data = NULL;
+				if(mywin->event.xselection.property == None) break;
+				if(XGetWindowProperty(mywin->dis, mywin->win, mywin->event.xselection.property, 0, 0x1000000, True, AnyPropertyType, &type, &format, &items, &after, &data) == Success && data && format == 8){
+					free(mywin->clipboard);
+					mywin->clipboard = malloc(items + 1);
+					mywin->clipboard_len = 0;
+					if(!mywin->clipboard){ XFree(data); break; } // No memory, the paste is dropped
+					memcpy(mywin->clipboard, data, items);
+					mywin->clipboard[items] = 0;
+					mywin->clipboard_len = items;
+				}
+				if(data) XFree(data);
+			}
+			break;
                         case MotionNotify:{// Mouse movement
                                 mywin->mouse.x_rel =  mywin->event.xmotion.x -old_x ;
                                 mywin->mouse.y_rel =  mywin->event.xmotion.y -old_y ;
@@ -204,6 +427,7 @@ void ikigui_window_get_events(ikigui_window *mywin){
 	void ikigui_breathe(int milisec){	usleep(milisec *1000);  } // pause
 
 	void ikigui_window_open(ikigui_window *mywin, char * name, int w, int h) { // input is the size of the window to create
+		ikigui_window_image_free(mywin); // If it's opened again, on the display it had
 		for(int i = 0 ; name[i] ; i++) mywin->name[i] = name[i] ; 
 		mywin->image.w = w;
 		mywin->image.h = h;
@@ -230,9 +454,8 @@ void ikigui_window_get_events(ikigui_window *mywin){
 		XWindowAttributes wa = {0};
 		XGetWindowAttributes(mywin->dis, mywin->win, &wa);
 
-		mywin->image.pixels = (unsigned int *)malloc(w * h * 4);
 		mywin->bitmap = XCreatePixmap(mywin->dis, mywin->win, w, h, 1);
-		mywin->ximage = XCreateImage(mywin->dis, wa.visual, wa.depth, ZPixmap, 0, (char*)mywin->image.pixels, w, h, 32, w * 4);
+		ikigui_window_image_make(mywin, wa.visual, wa.depth, w, h);
 		
 	};
 
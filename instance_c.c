@@ -0,0 +1,103 @@
+// Machine instances for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after snapshot_c.c.
+// Many machines can be kept from one warm template (a snapshot at READY, see snapshot_boot()). One of them runs at a time, in the globals.
+// An instance is the CPU and chip state, and only the 256 byte pages of memory it has written (copy on write), the rest is the template's.
+// write6502() marks the RAM pages the CPU writes in pla_written. When an instance is left, those pages, and pages the host has written
+// (traps, loaders, found by comparing with the template), are copied out. Switching copies only the pages the two instances have of their own.
+
+#define INSTANCE_PAGES	((sizeof(sysram) + sizeof(color_ram) + sizeof(shaddow_io)) / 256)	// 256 RAM, 4 color RAM and 16 I/O pages
+
+typedef struct {
+	snapshot_machine machine;
+	uint8_t         *page[INSTANCE_PAGES];	// Pages of its own, NULL = the template's
+	int              pages;
+	chrout_stream   *chrout;		// Where what it prints goes, NULL = nowhere
+} instance;
+
+static const snapshot_state *instance_template;
+static instance *instance_active;
+static uint8_t   instance_loaded[INSTANCE_PAGES];	// Pages in the globals that are not the template's
+
+static uint8_t *instance_memory(int p){ // Page p of the memory of the machine
+	if(p < 256) return &sysram[p << 8];
+	if(p < 260) return &color_ram[(p - 256) << 8];
+	return &shaddow_io[(p - 260) << 8];
+}
+
+static const uint8_t *instance_template_page(int p){
+	if(p < 256) return &instance_template->sysram[p << 8];
+	if(p < 260) return &instance_template->color_ram[(p - 256) << 8];
+	return &instance_template->shaddow_io[(p - 260) << 8];
+}
+
+/// Use t as the template for new instances, and set the machine to it. t must be kept as long as there are instances.
+void instance_set_template(const snapshot_state *t){
+	instance_template = t;
+	instance_active   = NULL;
+	snapshot_restore(t);
+	memset(instance_loaded, 0, sizeof(instance_loaded));
+	pla_clear_written(PLA_WRITTEN_INSTANCE);
+}
+
+static int instance_own(int p){ // Page p in the globals is not the template's
+	return (p < 256 && (pla_written[p] & PLA_WRITTEN_INSTANCE)) || instance_loaded[p] || memcmp(instance_memory(p), instance_template_page(p), 256);
+}
+
+/// A new machine, as the template. No memory is copied. NULL if there is no memory.
+instance *instance_new(void){
+	instance *i = calloc(1, sizeof(instance));
+	if(!i) return NULL;
+	i->machine = instance_template->machine;
+	return i;
+}
+
+/// Keep the running instance, the pages it has changed are copied out of the globals. Returns 0 if there is no memory, then it's still running.
+int instance_leave(void){
+	instance *i = instance_active;
+	if(!i) return 1;
+	for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++){
+		if(!instance_own(p)) continue; // Still the template's
+		if(!i->page[p]){
+			if(!(i->page[p] = malloc(256))) return 0;
+			i->pages++;
+		}
+		memcpy(i->page[p], instance_memory(p), 256);
+		instance_loaded[p] = 1;
+	}
+	snapshot_take_machine(&i->machine);
+	pla_clear_written(PLA_WRITTEN_INSTANCE);
+	instance_active = NULL;
+	return 1;
+}
+
+/// Run i from now on, the running instance is left first. Returns 0 if there is no memory to leave it, then it's still running.
+int instance_enter(instance *i){
+	if(i == instance_active) return 1;
+	if(!instance_leave()) return 0;
+	for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++){
+		if(i->page[p]){
+			memcpy(instance_memory(p), i->page[p], 256);
+			instance_loaded[p] = 1;
+		}else if(instance_loaded[p]){ // The last one had it, back to the template's
+			memcpy(instance_memory(p), instance_template_page(p), 256);
+			instance_loaded[p] = 0;
+		}
+	}
+	snapshot_restore_machine(&i->machine);
+	pla_clear_written(PLA_WRITTEN_INSTANCE);
+	instance_active = i;
+	chrout_active   = i->chrout;
+	return 1;
+}
+
+/// Memory the instance has of its own, in bytes.
+size_t instance_size(const instance *i){ return sizeof(instance) + (size_t)i->pages * 256; }
+
+void instance_free(instance *i){
+	if(i == instance_active){ // Nothing is copied out, but the pages it has changed are not the template's
+		for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++) if(instance_own(p)) instance_loaded[p] = 1;
+		pla_clear_written(PLA_WRITTEN_INSTANCE);
+		instance_active = NULL;
+	}
+	for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++) free(i->page[p]);
+	free(i);
+}
@@ -0,0 +1,121 @@
+// Input journal for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after paste_c.c.
+// Input only comes into the emulation in the host slices (host_slice() in C64_BASIC_EMU.c), and they are on fixed cycles. Recording writes every
+// key event and paste with the cycle of the slice it came in. Replaying gives them to the key queue in the slice on the same cycle, so the
+// emulation runs the same instructions on the same cycles. A replay doesn't wait for the real time or take X events, and ends with the numbers for a benchmark.
+// The journal is text, one line per event:
+//	cycle K keycode keysym state down repeat
+//	cycle P fast hex		A paste (F12), the text as hex
+//	cycle E				The end of the recording
+
+#define JOURNAL_HEADER	"C64 input journal 1\n"
+
+static FILE    *journal_file;
+static int      journal_replaying;
+static unsigned journal_seen;			// Key queue index up to where the events are recorded
+static char    *journal_line;			// The next line of a replay...
+static size_t   journal_line_size;
+static uint64_t journal_next = SCHED_NEVER;	// ...and its cycle
+static int      journal_end_event;		// At the cycle of the end line
+static uint64_t journal_start_cycles, journal_start_instructions;
+static struct timespec journal_start;
+
+static uint64_t journal_hash(void){ // Of the memory, to see that a replay ended the same (FNV-1a)
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for(int i = 0 ; i < 0x10000 ; i++) hash = (hash ^ sysram[i]) * 0x100000001B3ULL;
+	for(int i = 0 ; i < 1024 ; i++)    hash = (hash ^ color_ram[i]) * 0x100000001B3ULL;
+	return hash;
+}
+
+static void journal_end(void){ // The window is closed (exit), the end is now
+	fprintf(journal_file, "%llu E\n", (unsigned long long)clockticks6502);
+	fclose(journal_file);
+	printf("Recorded %llu cycles, memory hash %016llX\n", (unsigned long long)clockticks6502, (unsigned long long)journal_hash());
+}
+
+/// Record the input to a journal file. Returns 0 if it can't be written.
+int journal_record(const char *name){
+	if(!(journal_file = fopen(name, "w"))) return 0;
+	fputs(JOURNAL_HEADER, journal_file);
+	journal_seen = atomic_load(&mywin.keys.tail);
+	atexit(journal_end);
+	return 1;
+}
+
+static void journal_read(void){ // The next line and its cycle, the end is a event on its cycle (it's not in a slice)
+	unsigned long long cycle;
+	char type;
+	if(getline(&journal_line, &journal_line_size, journal_file) < 0 || sscanf(journal_line, "%llu %c", &cycle, &type) != 2){
+		printf("The journal ends without an end\n");
+		exit(1);
+	}
+	journal_next = type == 'E' ? SCHED_NEVER : cycle;
+	if(type == 'E') sched_at(journal_end_event, cycle);
+}
+
+static void journal_replay_end(int param, uint64_t when){ // The numbers, and the hash
+	(void)param; (void)when;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double seconds = (now.tv_sec - journal_start.tv_sec) + (now.tv_nsec - journal_start.tv_nsec) / 1e9;
+	uint64_t cycles = clockticks6502 - journal_start_cycles;
+	printf("Replay: %llu cycles, %llu instructions in %.3f s, %.2f MHz (%.1f x real time), memory hash %016llX\n",
+		(unsigned long long)cycles, (unsigned long long)(instructions6502 - journal_start_instructions), seconds,
+		cycles / seconds / 1e6, cycles / seconds / CIA_CLOCK, (unsigned long long)journal_hash());
+	exit(0);
+}
+
+/// Replay the input from a journal file instead of the keyboard. Returns 0 if it can't be read.
+int journal_replay(const char *name){
+	if(!(journal_file = fopen(name, "r"))) return 0;
+	if(getline(&journal_line, &journal_line_size, journal_file) < 0 || strcmp(journal_line, JOURNAL_HEADER)){ fclose(journal_file); return 0; }
+	journal_replaying = 1;
+	journal_end_event = sched_add("Journal end", journal_replay_end, 0);
+	journal_start_cycles = clockticks6502;
+	journal_start_instructions = instructions6502;
+	clock_gettime(CLOCK_MONOTONIC, &journal_start);
+	journal_read();
+	return 1;
+}
+
+/// Record a paste.
+void journal_paste(const char *text, size_t len, int fast){
+	if(!journal_file || journal_replaying) return;
+	fprintf(journal_file, "%llu P %d ", (unsigned long long)clockticks6502, fast);
+	for(size_t i = 0 ; i < len ; i++) fprintf(journal_file, "%02X", (uint8_t)text[i]);
+	fputc('\n', journal_file);
+}
+
+/// In every host slice, before the keys are taken: write the key events that has come, or give the ones that came in this slice when it was recorded.
+void journal_slice(void){
+	if(!journal_file) return;
+	if(!journal_replaying){
+		unsigned tail = atomic_load(&mywin.keys.tail);
+		for( ; journal_seen != tail ; journal_seen++){
+			const ikigui_key_event *e = &mywin.keys.event[journal_seen & (IKIGUI_KEY_QUEUE - 1)];
+			fprintf(journal_file, "%llu K %u %lu %u %d %d\n", (unsigned long long)clockticks6502, e->keycode, (unsigned long)e->keysym, e->state, e->down, e->repeat);
+		}
+		fflush(journal_file);
+		return;
+	}
+	while(journal_next <= clockticks6502){
+		unsigned long long cycle;
+		char type;
+		int n = 0;
+		if(sscanf(journal_line, "%llu %c %n", &cycle, &type, &n) < 2) type = 0;
+		const char *args = journal_line + n;
+		if(type == 'K'){
+			unsigned keycode, state;
+			unsigned long keysym;
+			int down, repeat;
+			if(sscanf(args, "%u %lu %u %d %d", &keycode, &keysym, &state, &down, &repeat) == 5) ikigui_key_push(&mywin, keycode, keysym, state, down, repeat);
+		}else if(type == 'P'){
+			int fast = 0, len = 0;
+			char *text = malloc(strlen(args) / 2 + 1);
+			if(!text){ printf("Out of memory for the journal\n"); exit(1); }
+			if(sscanf(args, "%d %n", &fast, &n) == 1) for(args += n ; sscanf(args, "%2hhx", (unsigned char*)&text[len]) == 1 ; args += 2) len++;
+			if(!paste_text(text, len, fast)){ printf("Out of memory for the journal\n"); exit(1); }
+			free(text);
+		}
+		journal_read();
+	}
+}
@@ -0,0 +1,162 @@
+// C64 keyboard matrix for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, before cia_c.c that reads it.
+// The host keys comes as down/up events from the ikiGUI key queue, and are mapped symbolically: the character on the host key is what the C64 gets,
+// so " (shift+' on a PC) becomes SHIFT+2 on the C64. Keys that need another SHIFT than the host has overrides the SHIFT keys in the matrix.
+// Several keys can be down at the same time, the KERNAL scan sees them like on the real keyboard.
+
+enum { // C64 keys, column (CIA #1 port A bit) * 8 + row (port B bit)
+	K_DEL = 0, K_RETURN, K_RIGHT, K_F7, K_F1, K_F3, K_F5, K_DOWN,
+	K_3, K_W, K_A, K_4, K_Z, K_S, K_E, K_LSHIFT,
+	K_5, K_R, K_D, K_6, K_C, K_F, K_T, K_X,
+	K_7, K_Y, K_G, K_8, K_B, K_H, K_U, K_V,
+	K_9, K_I, K_J, K_0, K_M, K_K, K_O, K_N,
+	K_PLUS, K_P, K_L, K_MINUS, K_PERIOD, K_COLON, K_AT, K_COMMA,
+	K_POUND, K_ASTERISK, K_SEMICOLON, K_HOME, K_RSHIFT, K_EQUAL, K_UPARROW, K_SLASH,
+	K_1, K_LEFTARROW, K_CTRL, K_2, K_SPACE, K_CBM, K_Q, K_STOP,
+	K_RESTORE	// Not in the matrix, it's connected to NMI
+};
+enum { SH_NONE = 0, SH_ANY, SH_OFF, SH_ON }; // SHIFT for a mapped key, SH_NONE = not mapped
+
+typedef struct { uint8_t key, shift; } keyboard_map_entry;
+
+#define KEYBOARD_MIN_HOLD	20000	// Cycles a key is held at least, more than the 1/60 s between the KERNAL scans, so a fast tap is never lost
+#define KEYBOARD_MAX_DOWN	16
+
+static const keyboard_map_entry keyboard_ascii[128] = { // Printable characters
+	[' '] = {K_SPACE, SH_ANY},
+	['a'] = {K_A, SH_OFF}, ['b'] = {K_B, SH_OFF}, ['c'] = {K_C, SH_OFF}, ['d'] = {K_D, SH_OFF}, ['e'] = {K_E, SH_OFF}, ['f'] = {K_F, SH_OFF}, ['g'] = {K_G, SH_OFF},
+	['h'] = {K_H, SH_OFF}, ['i'] = {K_I, SH_OFF}, ['j'] = {K_J, SH_OFF}, ['k'] = {K_K, SH_OFF}, ['l'] = {K_L, SH_OFF}, ['m'] = {K_M, SH_OFF}, ['n'] = {K_N, SH_OFF},
+	['o'] = {K_O, SH_OFF}, ['p'] = {K_P, SH_OFF}, ['q'] = {K_Q, SH_OFF}, ['r'] = {K_R, SH_OFF}, ['s'] = {K_S, SH_OFF}, ['t'] = {K_T, SH_OFF}, ['u'] = {K_U, SH_OFF},
+	['v'] = {K_V, SH_OFF}, ['w'] = {K_W, SH_OFF}, ['x'] = {K_X, SH_OFF}, ['y'] = {K_Y, SH_OFF}, ['z'] = {K_Z, SH_OFF},
+	['A'] = {K_A, SH_ON},  ['B'] = {K_B, SH_ON},  ['C'] = {K_C, SH_ON},  ['D'] = {K_D, SH_ON},  ['E'] = {K_E, SH_ON},  ['F'] = {K_F, SH_ON},  ['G'] = {K_G, SH_ON},
+	['H'] = {K_H, SH_ON},  ['I'] = {K_I, SH_ON},  ['J'] = {K_J, SH_ON},  ['K'] = {K_K, SH_ON},  ['L'] = {K_L, SH_ON},  ['M'] = {K_M, SH_ON},  ['N'] = {K_N, SH_ON},
+	['O'] = {K_O, SH_ON},  ['P'] = {K_P, SH_ON},  ['Q'] = {K_Q, SH_ON},  ['R'] = {K_R, SH_ON},  ['S'] = {K_S, SH_ON},  ['T'] = {K_T, SH_ON},  ['U'] = {K_U, SH_ON},
+	['V'] = {K_V, SH_ON},  ['W'] = {K_W, SH_ON},  ['X'] = {K_X, SH_ON},  ['Y'] = {K_Y, SH_ON},  ['Z'] = {K_Z, SH_ON},
+	['0'] = {K_0, SH_OFF}, ['1'] = {K_1, SH_OFF}, ['2'] = {K_2, SH_OFF}, ['3'] = {K_3, SH_OFF}, ['4'] = {K_4, SH_OFF},
+	['5'] = {K_5, SH_OFF}, ['6'] = {K_6, SH_OFF}, ['7'] = {K_7, SH_OFF}, ['8'] = {K_8, SH_OFF}, ['9'] = {K_9, SH_OFF},
+	['!'] = {K_1, SH_ON},  ['"'] = {K_2, SH_ON},  ['#'] = {K_3, SH_ON},  ['$'] = {K_4, SH_ON},  ['%'] = {K_5, SH_ON},
+	['&'] = {K_6, SH_ON},  ['\''] = {K_7, SH_ON}, ['('] = {K_8, SH_ON},  [')'] = {K_9, SH_ON},
+	['+'] = {K_PLUS, SH_OFF},  ['-'] = {K_MINUS, SH_OFF}, ['*'] = {K_ASTERISK, SH_OFF}, ['/'] = {K_SLASH, SH_OFF},  ['='] = {K_EQUAL, SH_OFF},
+	[':'] = {K_COLON, SH_OFF}, [';'] = {K_SEMICOLON, SH_OFF}, [','] = {K_COMMA, SH_OFF}, ['.'] = {K_PERIOD, SH_OFF}, ['@'] = {K_AT, SH_OFF},
+	['['] = {K_COLON, SH_ON},  [']'] = {K_SEMICOLON, SH_ON},  ['<'] = {K_COMMA, SH_ON},  ['>'] = {K_PERIOD, SH_ON},  ['?'] = {K_SLASH, SH_ON},
+	['^'] = {K_UPARROW, SH_OFF}, ['_'] = {K_LEFTARROW, SH_OFF}, ['\\'] = {K_POUND, SH_OFF}, // PETSCII has arrow up, arrow left and pound on these codes
+};
+
+static keyboard_map_entry keyboard_map(KeySym sym){ // Host key symbol -> C64 key
+	keyboard_map_entry none = {0, SH_NONE};
+	if(sym >= 0x20 && sym < 0x7F) return keyboard_ascii[sym];
+	switch(sym){
+		case XK_Return: case XK_KP_Enter:	return (keyboard_map_entry){K_RETURN, SH_ANY};
+		case XK_BackSpace: case XK_Delete:	return (keyboard_map_entry){K_DEL,    SH_OFF};
+		case XK_Insert:				return (keyboard_map_entry){K_DEL,    SH_ON};
+		case XK_Home:				return (keyboard_map_entry){K_HOME,   SH_ANY};	// SHIFT+HOME is CLR
+		case XK_Right:				return (keyboard_map_entry){K_RIGHT,  SH_OFF};
+		case XK_Left:				return (keyboard_map_entry){K_RIGHT,  SH_ON};
+		case XK_Down:				return (keyboard_map_entry){K_DOWN,   SH_OFF};
+		case XK_Up:				return (keyboard_map_entry){K_DOWN,   SH_ON};
+		case XK_F1:				return (keyboard_map_entry){K_F1,     SH_OFF};
+		case XK_F2:				return (keyboard_map_entry){K_F1,     SH_ON};
+		case XK_F3:				return (keyboard_map_entry){K_F3,     SH_OFF};
+		case XK_F4:				return (keyboard_map_entry){K_F3,     SH_ON};
+		case XK_F5:				return (keyboard_map_entry){K_F5,     SH_OFF};
+		case XK_F6:				return (keyboard_map_entry){K_F5,     SH_ON};
+		case XK_F7:				return (keyboard_map_entry){K_F7,     SH_OFF};
+		case XK_F8:				return (keyboard_map_entry){K_F7,     SH_ON};
+		case XK_Shift_L:			return (keyboard_map_entry){K_LSHIFT, SH_ANY};
+		case XK_Shift_R:			return (keyboard_map_entry){K_RSHIFT, SH_ANY};
+		case XK_Control_L: case XK_Control_R:	return (keyboard_map_entry){K_CTRL,   SH_ANY};
+		case XK_Alt_L: case XK_Super_L:		return (keyboard_map_entry){K_CBM,    SH_ANY};	// Commodore key
+		case XK_Tab: case XK_Escape:		return (keyboard_map_entry){K_STOP,   SH_ANY};	// RUN/STOP
+		case XK_Prior:				return (keyboard_map_entry){K_RESTORE, SH_ANY};	// Page Up
+	}
+	return none;
+}
+
+static struct {
+	unsigned keycode;	// Host key
+	uint8_t  key, shift;	// What it's on the C64
+	uint64_t since;		// Cycle it went down
+} keyboard_down[KEYBOARD_MAX_DOWN];
+static int keyboard_down_count;
+
+uint8_t keyboard_matrix[8];		// Pressed keys, a bit for every row in every column
+static ikigui_window *keyboard_win;	// Where the key events comes from
+static int keyboard_event;		// Scheduler event, for releasing a key that was tapped too fast for the scan
+int keyboard_rewind;			// F9 was pressed, the main loop rewinds (rewind_c.c)
+
+static void keyboard_build(void){ // Make the matrix from the keys that are down
+	int shift = SH_ANY;
+	memset(keyboard_matrix, 0, sizeof(keyboard_matrix));
+	for(int i = 0 ; i < keyboard_down_count ; i++){
+		uint8_t key = keyboard_down[i].key;
+		if(key == K_RESTORE) continue;
+		keyboard_matrix[key >> 3] |= 1 << (key & 7);
+		if(keyboard_down[i].shift != SH_ANY) shift = keyboard_down[i].shift; // The last pressed key decides SHIFT
+	}
+	if(shift == SH_ON)  keyboard_matrix[K_LSHIFT >> 3] |= 1 << (K_LSHIFT & 7);
+	if(shift == SH_OFF){
+		keyboard_matrix[K_LSHIFT >> 3] &= ~(1 << (K_LSHIFT & 7));
+		keyboard_matrix[K_RSHIFT >> 3] &= ~(1 << (K_RSHIFT & 7));
+	}
+}
+
+static void keyboard_release(int i){
+	if(keyboard_down[i].key == K_RESTORE) nmi_set(NMI_RESTORE, 0);
+	memmove(&keyboard_down[i], &keyboard_down[i + 1], (--keyboard_down_count - i) * sizeof(keyboard_down[0])); // Keep the order the keys went down in
+}
+
+/// Take the key events from the queue into the matrix. A release of a key that has been down a shorter time than KEYBOARD_MIN_HOLD waits, and so does everything after it.
+void keyboard_update(void){
+	ikigui_key_event e;
+	uint64_t now = clockticks6502;
+	while(ikigui_key_peek(keyboard_win, &e)){
+		if(e.down){
+			if(e.keysym == XK_F12 && !e.repeat) ikigui_clipboard_request(keyboard_win); // Not a C64 key, pastes the host clipboard (paste_c.c)
+			if(e.keysym == XK_F9 && !e.repeat) keyboard_rewind++; // Not a C64 key either, goes back in time
+			if(!e.repeat && keyboard_down_count < KEYBOARD_MAX_DOWN){ // The KERNAL makes it's own repeat
+				keyboard_map_entry m = keyboard_map(e.keysym);
+				if(m.shift != SH_NONE){
+					keyboard_down[keyboard_down_count].keycode = e.keycode;
+					keyboard_down[keyboard_down_count].key     = m.key;
+					keyboard_down[keyboard_down_count].shift   = m.shift;
+					keyboard_down[keyboard_down_count].since   = now;
+					keyboard_down_count++;
+					if(m.key == K_RESTORE) nmi_set(NMI_RESTORE, 1);
+				}
+			}
+		}else{
+			uint64_t until = 0;
+			for(int i = 0 ; i < keyboard_down_count ; i++){
+				if((e.keycode == 0 || keyboard_down[i].keycode == e.keycode) && keyboard_down[i].since + KEYBOARD_MIN_HOLD > until) until = keyboard_down[i].since + KEYBOARD_MIN_HOLD;
+			}
+			if(until > now){ // Too soon, try again when it has been down long enough
+				sched_at(keyboard_event, until);
+				break;
+			}
+			for(int i = keyboard_down_count - 1 ; i >= 0 ; i--) if(e.keycode == 0 || keyboard_down[i].keycode == e.keycode) keyboard_release(i);
+		}
+		ikigui_key_pop(keyboard_win, &e);
+	}
+	keyboard_build();
+}
+
+/// Release every key now, also the events in the queue and the releases that waits for KEYBOARD_MIN_HOLD. For when another machine runs.
+void keyboard_release_all(void){
+	ikigui_key_event e;
+	while(ikigui_key_pop(keyboard_win, &e));
+	while(keyboard_down_count) keyboard_release(keyboard_down_count - 1);
+	sched_cancel(keyboard_event);
+	keyboard_build();
+}
+
+static void keyboard_event_release(int param, uint64_t when){ (void)param; (void)when; keyboard_update(); }
+
+void keyboard_init(ikigui_window *win){
+	keyboard_win = win;
+	keyboard_event = sched_add("Keyboard", keyboard_event_release, 0);
+}
+
+uint8_t keyboard_rows(uint8_t columns){ // CIA #1 port B, the rows pulled low by pressed keys in the selected (low) columns of port A
+	uint8_t rows = 0;
+	for(int c = 0 ; c < 8 ; c++) if(!(columns & (1 << c))) rows |= keyboard_matrix[c];
+	return ~rows;
+}
@@ -0,0 +1,91 @@
+// Paste and autotype for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after vic_c.c.
+// Text is not typed on the keyboard matrix. It's converted to PETSCII and waits in a host side FIFO, and a event puts it in the KERNAL keyboard buffer
+// (0x0277, with the count in 0xC6) as fast as the KERNAL takes it out, but never more than the buffer size in 0x0289. So nothing is lost, also not in a long listing.
+// A fast paste runs the emulation as fast as it can, without drawing the frames, until the FIFO is empty.
+
+#define PASTE_INTERVAL		1000	// Cycles between the looks at the keyboard buffer
+#define PASTE_KEYBUF		0x0277	// KERNAL keyboard buffer...
+#define PASTE_KEYBUF_COUNT	0xC6	// ...chars in it...
+#define PASTE_KEYBUF_SIZE	0x0289	// ...and the max the KERNAL uses
+#define PASTE_KEYBUF_MAX	10	// The RAM that is for the buffer, 0x0289 is not trusted to be less
+
+static uint8_t *paste_fifo;	// PETSCII waiting to be typed
+static size_t   paste_len, paste_pos, paste_size;
+static int      paste_event;
+static int      paste_started;	// The editor has waited for a key, so the KERNAL is up and the buffer is used
+int             paste_fast;	// Fast forward until the FIFO is empty, is read by the main loop
+
+// ASCII -> PETSCII, 0 = not typed. Both upper and lower case letters are the unshifted letters, as that is what BASIC keywords are in the default char set.
+static const uint8_t paste_petscii[128] = {
+	['\t'] = ' ', ['\n'] = 0x0D, // '\r' is dropped, so text with CR LF has one RETURN per line
+	[' '] = ' ', ['!'] = '!', ['"'] = '"', ['#'] = '#', ['$'] = '$', ['%'] = '%', ['&'] = '&', ['\''] = '\'',
+	['('] = '(', [')'] = ')', ['*'] = '*', ['+'] = '+', [','] = ',', ['-'] = '-', ['.'] = '.', ['/'] = '/',
+	['0'] = '0', ['1'] = '1', ['2'] = '2', ['3'] = '3', ['4'] = '4', ['5'] = '5', ['6'] = '6', ['7'] = '7',
+	['8'] = '8', ['9'] = '9', [':'] = ':', [';'] = ';', ['<'] = '<', ['='] = '=', ['>'] = '>', ['?'] = '?', ['@'] = '@',
+	['A'] = 0x41, ['B'] = 0x42, ['C'] = 0x43, ['D'] = 0x44, ['E'] = 0x45, ['F'] = 0x46, ['G'] = 0x47, ['H'] = 0x48, ['I'] = 0x49,
+	['J'] = 0x4A, ['K'] = 0x4B, ['L'] = 0x4C, ['M'] = 0x4D, ['N'] = 0x4E, ['O'] = 0x4F, ['P'] = 0x50, ['Q'] = 0x51, ['R'] = 0x52,
+	['S'] = 0x53, ['T'] = 0x54, ['U'] = 0x55, ['V'] = 0x56, ['W'] = 0x57, ['X'] = 0x58, ['Y'] = 0x59, ['Z'] = 0x5A,
+	['a'] = 0x41, ['b'] = 0x42, ['c'] = 0x43, ['d'] = 0x44, ['e'] = 0x45, ['f'] = 0x46, ['g'] = 0x47, ['h'] = 0x48, ['i'] = 0x49,
+	['j'] = 0x4A, ['k'] = 0x4B, ['l'] = 0x4C, ['m'] = 0x4D, ['n'] = 0x4E, ['o'] = 0x4F, ['p'] = 0x50, ['q'] = 0x51, ['r'] = 0x52,
+	['s'] = 0x53, ['t'] = 0x54, ['u'] = 0x55, ['v'] = 0x56, ['w'] = 0x57, ['x'] = 0x58, ['y'] = 0x59, ['z'] = 0x5A,
+	['['] = 0x5B, ['\\'] = 0x5C, [']'] = 0x5D, ['^'] = 0x5E, ['_'] = 0x5F, // Pound, arrow up and arrow left are on these codes
+};
+
+/// The screen editor is in its loop waiting for a key (0xE5CD - 0xE5D4 in the KERNAL), so BASIC is at READY or in INPUT.
+int editor_waiting(void){ return pc >= 0xE5CD && pc <= 0xE5D4; }
+
+static void paste_refill(int param, uint64_t when){ // Top up the keyboard buffer from the FIFO
+	(void)param;
+	if(!paste_started && !editor_waiting()){ sched_at(paste_event, when + PASTE_INTERVAL); return; } // Still booting, the KERNAL would clear the buffer
+	paste_started = 1;
+	if(!editor_waiting() && sysram[PASTE_KEYBUF_COUNT]){ sched_at(paste_event, when + PASTE_INTERVAL); return; } // GETIN (0xE5B4) may be between moving the chars down and the DEC of the count
+	uint8_t size = sysram[PASTE_KEYBUF_SIZE] < PASTE_KEYBUF_MAX ? sysram[PASTE_KEYBUF_SIZE] : PASTE_KEYBUF_MAX;
+	while(paste_pos < paste_len && sysram[PASTE_KEYBUF_COUNT] < size) sysram[PASTE_KEYBUF + sysram[PASTE_KEYBUF_COUNT]++] = paste_fifo[paste_pos++];
+	if(paste_pos < paste_len){ sched_at(paste_event, when + PASTE_INTERVAL); return; }
+	paste_len = paste_pos = 0; // All is in the buffer
+	paste_fast = 0;
+	vic_skip_render = 0;
+}
+
+/// Type the text (ASCII, other bytes are skipped), after what is waiting already. fast = run the emulation without drawing until it's typed.
+/// Returns 0 if there is no memory, then nothing of it is typed.
+int paste_text(const char *text, size_t len, int fast){
+	if(paste_len + len > paste_size){
+		uint8_t *fifo = realloc(paste_fifo, paste_len + len);
+		if(!fifo) return 0;
+		paste_fifo = fifo;
+		paste_size = paste_len + len;
+	}
+	for(size_t i = 0 ; i < len ; i++){
+		uint8_t c = text[i];
+		if(c < 128 && paste_petscii[c]) paste_fifo[paste_len++] = paste_petscii[c];
+	}
+	if(paste_pos == paste_len) return 1;
+	paste_fast |= fast;
+	vic_skip_render = paste_fast;
+	if(sched_when(paste_event) == SCHED_NEVER) sched_at(paste_event, clockticks6502);
+	return 1;
+}
+
+/// Type a file, returns 0 if it can't be read (or there is no memory).
+int paste_file(const char *name, int fast){
+	FILE *f = fopen(name, "rb");
+	if(!f) return 0;
+	char buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+		if(!paste_text(buf, n, fast)){ fclose(f); return 0; }
+	}
+	fclose(f);
+	return 1;
+}
+
+/// Drop what is waiting to be typed.
+void paste_cancel(void){
+	paste_len = paste_pos = 0;
+	paste_fast = 0;
+	vic_skip_render = 0;
+	sched_cancel(paste_event);
+}
+
+void paste_init(void){ paste_event = sched_add("Paste", paste_refill, 0); }
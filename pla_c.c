@@ -0,0 +1,72 @@
+// PLA memory map for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, before read6502() and write6502() that use it.
+// The map is not worked out on every access. It's a table with where every 256 byte page is read from and written to, that is made again
+// when the CPU port (0x01) or the cartridge /GAME and /EXROM lines change. A cartridge bank switch only points the ROML and ROMH pages to the new bank.
+// Cart mode is selected by /GAME and /EXROM, that defaults to 11 (pull up resistors) if no cart is present:
+//	/GAME /EXROM
+//	  1     0	 8K cart, ROML at 0x8000 - 0x9FFF
+//	  0     0	16K cart, ROML at 0x8000 and ROMH at 0xA000 - 0xBFFF
+//	  0     1	Ultimax, ROML at 0x8000, ROMH at 0xE000 - 0xFFFF and only 4K RAM, for example the dead test cartridge
+//	  1     1	No cart
+
+uint8_t        pla_game = 1, pla_exrom = 1;	// Cartridge lines, 0 = pulled low by a cart
+const uint8_t *pla_roml, *pla_romh;		// The 8K banks the cart has at ROML and ROMH now (NULL = no ROM there)
+const uint8_t *pla_read[256];			// Where the CPU reads every page, NULL = I/O
+uint8_t       *pla_write[256];			// Where the CPU writes every page, NULL = I/O
+uint8_t        pla_written[256];		// RAM pages the CPU has written, a bit for every user that clears only its own...
+#define PLA_WRITTEN_INSTANCE	0x01		// ...instance_c.c
+#define PLA_WRITTEN_REWIND	0x02		// ...rewind_c.c
+static uint8_t pla_open[256];			// Pages that are not connected in Ultimax mode reads 0xFF...
+static uint8_t pla_lost[256];			// ...and writes to them are lost here
+static uint8_t pla_romh_page;			// 0xA0 or 0xE0 when ROMH is mapped, 0 if not
+static uint8_t pla_roml_mapped;
+
+static void pla_map(int first, int last, const uint8_t *read, uint8_t *write){ // Pages first - last, read and write are for the first page
+	for(int p = first ; p <= last ; p++){
+		pla_read[p]  = read  ? read  + (p - first) * 256 : NULL;
+		pla_write[p] = write ? write + (p - first) * 256 : NULL;
+	}
+}
+
+static void pla_map_cart(void){ // ROML and ROMH pages, writes goes to the RAM under them (or are lost in Ultimax)
+	int ultimax = !pla_game && pla_exrom;
+	for(int p = 0 ; p < 0x20 ; p++){
+		if(pla_roml_mapped) pla_read[0x80 + p] = pla_roml ? pla_roml + p * 256 : pla_open;
+		if(pla_romh_page)   pla_read[pla_romh_page + p] = pla_romh ? pla_romh + p * 256 : pla_open;
+		if(ultimax){
+			pla_write[0x80 + p] = pla_lost;
+			pla_write[0xE0 + p] = pla_lost;
+		}
+	}
+}
+
+/// Make the map again, after a write to 0x01 or a change of /GAME or /EXROM.
+void pla_update(void){
+	uint8_t port = sysram[1] & 0x07;
+	int loram = port & 1, hiram = (port >> 1) & 1, charen = (port >> 2) & 1;
+	memset(pla_open, 0xFF, sizeof(pla_open));
+	pla_map(0x00, 0xFF, sysram, sysram); // RAM, and then what is on top of it
+	pla_roml_mapped = 0;
+	pla_romh_page   = 0;
+	if(!pla_game && pla_exrom){ // Ultimax: ROML, I/O and ROMH, and the RAM only at 0x0000 - 0x0FFF. The CPU port does nothing.
+		for(int p = 0x10 ; p <= 0xCF ; p++){ pla_read[p] = pla_open; pla_write[p] = pla_lost; }
+		pla_map(0xD0, 0xDF, NULL, NULL);
+		pla_roml_mapped = 1;
+		pla_romh_page   = 0xE0;
+		pla_map_cart();
+		return;
+	}
+	if(loram && hiram && !pla_exrom)	pla_roml_mapped = 1;				// 8K and 16K cart
+	if(hiram && !pla_game && !pla_exrom)	pla_romh_page = 0xA0;				// 16K cart
+	else if(loram && hiram)			pla_map(0xA0, 0xBF, basic, sysram + 0xA000);	// BASIC ROM
+	if(hiram)				pla_map(0xE0, 0xFF, kernal, sysram + 0xE000);	// KERNAL ROM
+	if(loram || hiram){
+		if(charen)	pla_map(0xD0, 0xDF, NULL, NULL);				// I/O
+		else		pla_map(0xD0, 0xDF, characters, sysram + 0xD000);		// CHARACTER ROM
+	}
+	pla_map_cart();
+}
+
+void pla_clear_written(uint8_t bit){ for(int p = 0 ; p < 256 ; p++) pla_written[p] &= ~bit; }
+
+/// The cart has switched bank (pla_roml and pla_romh), only the pages it's mapped to are changed.
+void pla_bank(void){ pla_map_cart(); }
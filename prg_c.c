@@ -0,0 +1,195 @@
+// Program loader for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after paste_c.c.
+// A .prg is copied straight into RAM at its load address, and a .bas text file is tokenized on the host, with the keyword table in the BASIC ROM,
+// the same way CRUNCH (0xA579) does it for a typed line. The BASIC pointers are set up like after a LOAD, so it can be RUN at once.
+
+#define PRG_KEYWORDS	0x009E		// Offset of the keyword table in basic[] (0xA09E), the last char of every keyword has bit 7 set
+#define PRG_TXTTAB	0x2B		// Start of the BASIC program...
+#define PRG_VARTAB	0x2D		// ...and of the variables, after it
+#define PRG_ARYTAB	0x2F		// Arrays
+#define PRG_STREND	0x31		// End of arrays
+#define PRG_FRETOP	0x33		// Strings, grows down from MEMSIZ
+#define PRG_MEMSIZ	0x37		// End of BASIC RAM
+#define PRG_MAX_LINE	63999
+
+#define PRG_TOKEN_DATA	0x83
+#define PRG_TOKEN_REM	0x8F
+#define PRG_TOKEN_PRINT	0x99
+
+static uint16_t prg_word(uint16_t address){ return sysram[address] | (sysram[address + 1] << 8); }
+static void     prg_set_word(uint16_t address, uint16_t value){ sysram[address] = value & 0xFF; sysram[address + 1] = value >> 8; }
+
+static void prg_relink(uint32_t end){ // Make the line links point to the next line, like LINKPRG (0xA533)
+	uint32_t line = prg_word(PRG_TXTTAB);
+	while(line + 4 < end && sysram[line + 1]){ // A link with high byte 0 is the end
+		uint32_t p = line + 4;
+		while(p < end && sysram[p]) p++;
+		prg_set_word(line, p + 1);
+		line = p + 1;
+	}
+}
+
+static void prg_set_end(uint16_t end){ // The program ends at end, set the pointers like LOAD and CLR
+	prg_set_word(PRG_VARTAB, end);
+	prg_set_word(PRG_ARYTAB, end);
+	prg_set_word(PRG_STREND, end);
+	prg_set_word(PRG_FRETOP, prg_word(PRG_MEMSIZ));
+}
+
+/// Copy a .prg (load address and data) into RAM. If it's loaded at the start of BASIC it's a BASIC program, and the pointers are set.
+/// Returns the end address, or 0 if it doesn't fit.
+uint32_t prg_load(const uint8_t *data, size_t len){
+	if(len < 2) return 0;
+	uint16_t start = data[0] | (data[1] << 8);
+	if(start + len - 2 > 0x10000) return 0;
+	memcpy(&sysram[start], data + 2, len - 2);
+	uint32_t end = start + len - 2;
+	if(start == prg_word(PRG_TXTTAB) && end < 0x10000){
+		prg_relink(end);
+		prg_set_end(end);
+	}
+	return end;
+}
+
+static int prg_keyword(const uint8_t *in, int *len){ // The token for the keyword at in, first match in table order like CRUNCH, 0 = none
+	const uint8_t *kw = &basic[PRG_KEYWORDS];
+	for(int token = 0x80 ; *kw ; token++){
+		int i = 0;
+		while(1){
+			uint8_t d = in[i] - kw[i];
+			if(d == 0){ i++; continue; }
+			if(d == 0x80){ *len = i + 1; return token; } // Last char of the keyword (or a shifted letter, that is a abbreviation)
+			break;
+		}
+		while(!(*kw++ & 0x80)); // Next keyword
+	}
+	return 0;
+}
+
+static int prg_crunch(const uint8_t *in, uint8_t *out){ // Tokenize a line after the line number, returns the length. in ends with 0.
+	int n = 0, data = 0;
+	while(*in){
+		uint8_t c = *in;
+		if(c == '"'){ // Strings are not tokenized
+			out[n++] = *in++;
+			while(*in && *in != '"') out[n++] = *in++;
+			if(*in) out[n++] = *in++;
+			continue;
+		}
+		if(c >= 0x80 || c == ' ' || data || (c >= '0' && c < '<')){ // Stored as it is, ':' ends DATA
+			if(c == ':') data = 0;
+			out[n++] = *in++;
+			continue;
+		}
+		if(c == '?'){ out[n++] = PRG_TOKEN_PRINT; in++; continue; }
+		int len, token = prg_keyword(in, &len);
+		if(!token){ out[n++] = *in++; continue; }
+		out[n++] = token;
+		in += len;
+		if(token == PRG_TOKEN_DATA) data = 1;
+		if(token == PRG_TOKEN_REM) while(*in) out[n++] = *in++; // The rest of the line as it is
+	}
+	return n;
+}
+
+typedef struct { uint16_t number; uint32_t offset, len; } prg_line;
+
+static int prg_line_order(const void *a, const void *b){ // By number, and the last one in the text of a number wins
+	const prg_line *x = a, *y = b;
+	if(x->number != y->number) return x->number - y->number;
+	return x->offset < y->offset ? -1 : 1;
+}
+
+/// Tokenize a BASIC text (ASCII, one line per text line, a line number first) into the program memory, instead of the program that is there.
+/// Lines are sorted by number, and a line with only a number deletes it, like when typed. Returns the end address, or 0 on error (printed).
+uint32_t prg_tokenize(const char *text, size_t len){
+	uint8_t *tokens = malloc(len * 2 + 1), line[256], crunched[256]; // Tokens are never longer than the text
+	prg_line *lines = malloc((len / 2 + 1) * sizeof(prg_line));
+	int count = 0, line_nr = 0;
+	size_t used = 0;
+	if(!tokens || !lines){ printf("Out of memory for the tokenizer\n"); goto error; }
+	for(size_t i = 0 ; i < len ; ){
+		int n = 0;
+		line_nr++;
+		for( ; i < len && text[i] != '\n' ; i++){ // As PETSCII, as if it was typed
+			uint8_t c = text[i];
+			if(c < 128 && paste_petscii[c] && n < 255) line[n++] = paste_petscii[c];
+		}
+		i++;
+		line[n] = 0;
+		uint8_t *p = line;
+		while(*p == ' ') p++;
+		if(!*p) continue; // Empty lines are skipped
+		if(*p < '0' || *p > '9'){ printf("BASIC text line %d: no line number\n", line_nr); goto error; }
+		long number = 0;
+		while(*p >= '0' && *p <= '9' && number <= PRG_MAX_LINE) number = number * 10 + *p++ - '0'; // Stops when it's too large, before a long can overflow
+		if(number > PRG_MAX_LINE){ printf("BASIC text line %d: line number over %d\n", line_nr, PRG_MAX_LINE); goto error; }
+		while(*p == ' ') p++; // CHRGET skips the spaces after the number
+		n = prg_crunch(p, crunched);
+		lines[count].number = number;
+		lines[count].offset = used;
+		lines[count].len    = n;
+		memcpy(tokens + used, crunched, n);
+		used += n;
+		count++;
+	}
+	qsort(lines, count, sizeof(prg_line), prg_line_order);
+
+	uint16_t start = prg_word(PRG_TXTTAB), memsiz = prg_word(PRG_MEMSIZ);
+	uint32_t p = start;
+	for(int l = 0 ; l < count ; l++){
+		if(l + 1 < count && lines[l + 1].number == lines[l].number) continue; // A later one replaces it
+		if(!lines[l].len) continue; // Only a number, deletes the line
+		if(p + 5 + lines[l].len + 2 > memsiz){ printf("BASIC text: ?OUT OF MEMORY\n"); goto error; }
+		prg_set_word(p + 2, lines[l].number);
+		memcpy(&sysram[p + 4], tokens + lines[l].offset, lines[l].len);
+		sysram[p + 4 + lines[l].len] = 0;
+		prg_set_word(p, p + 5 + lines[l].len); // Link to the next line
+		p += 5 + lines[l].len;
+	}
+	prg_set_word(p, 0); // End of program
+	free(tokens);
+	free(lines);
+	prg_set_end(p + 2);
+	return p + 2;
+error:
+	free(tokens);
+	free(lines);
+	return 0;
+}
+
+static const char *prg_name;	// File to load when BASIC is READY...
+static int prg_run;		// ...and then RUN it
+static int prg_event;
+
+/// Load a .prg or a .bas (tokenized) file now. Returns the end address, or 0 on error.
+uint32_t prg_load_file(const char *name){
+	FILE *f = fopen(name, "rb");
+	if(!f){ printf("Can't read %s\n", name); return 0; }
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(len + 1);
+	if(!data || fread(data, 1, len, f) != (size_t)len){ printf("Can't read %s\n", name); fclose(f); free(data); return 0; }
+	fclose(f);
+	size_t name_len = strlen(name);
+	int text = name_len > 4 && !strcasecmp(name + name_len - 4, ".bas");
+	uint32_t end = text ? prg_tokenize((const char*)data, len) : prg_load(data, len);
+	if(!end && !text) printf("%s doesn't fit in the memory\n", name);
+	free(data);
+	return end;
+}
+
+static void prg_event_ready(int param, uint64_t when){ // Waits for READY, before that the KERNAL and BASIC init would clear the program
+	(void)param;
+	if(!editor_waiting()){ sched_at(prg_event, when + PASTE_INTERVAL); return; }
+	if(prg_load_file(prg_name) && prg_run) paste_text("RUN\n", 4, 0);
+}
+
+/// Load the file when BASIC has started and is READY, and RUN it if run is set.
+void prg_load_when_ready(const char *name, int run){
+	prg_name = name;
+	prg_run  = run;
+	sched_at(prg_event, clockticks6502);
+}
+
+void prg_init(void){ prg_event = sched_add("Program load", prg_event_ready, 0); }
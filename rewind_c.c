@@ -0,0 +1,143 @@
+// Rewind for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after instance_c.c.
+// Every REWIND_FRAMES frames a rewind point is taken: the CPU and chip state, and the 256 byte pages of memory that changed since the point before,
+// as a XOR with the old page and run length coded (mostly zeros). Every REWIND_KEY_EVERY points is a key point with all the pages.
+// The CPU writes are found with pla_written, and pages the host has written (loaders, drive traps) by comparing with the last point.
+// Going back decodes the nearest key point before and applies the deltas forward. When the memory budget is used, the oldest key point and its
+// deltas are dropped.
+
+#define REWIND_FRAMES		10	// A point every 0.2 s
+#define REWIND_KEY_EVERY	64	// Every 12.8 s
+#define REWIND_BACK		25	// Points F9 goes back, 5 s
+#define REWIND_MAX_POINTS	0x8000	// 109 minutes, if the budget allows
+
+typedef struct {
+	snapshot_machine machine;
+	uint8_t         *data;		// Pages: page number (2 bytes) and the run length coded XOR with the page in the point before (or with 0 in a key point)
+	uint32_t         len;
+	int              key;
+} rewind_point;
+
+static rewind_point *rewind_points;		// Ring, oldest at rewind_first
+static int           rewind_first, rewind_count, rewind_keys;
+static size_t        rewind_used, rewind_budget;
+static uint8_t       rewind_shadow[INSTANCE_PAGES * 256];	// The memory as it was at the last point
+static uint8_t      *rewind_buffer;				// A point is coded here before it's copied to its own size
+static int           rewind_event;
+static int           rewind_since_key;
+
+static rewind_point *rewind_at(int i){ return &rewind_points[(rewind_first + i) % REWIND_MAX_POINTS]; } // The i:th oldest
+
+static uint32_t rewind_rle(uint8_t *out, const uint8_t *mem, const uint8_t *old){ // Code mem XOR old: 0nnnnnnn = n+1 zeros, 1nnnnnnn = n+1 bytes that follows
+	uint32_t len = 0;
+	for(int i = 0 ; i < 256 ; ){
+		int n = 0;
+		while(i + n < 256 && n < 128 && mem[i + n] == old[i + n]) n++;
+		if(n){ out[len++] = n - 1; i += n; continue; }
+		while(i + n < 256 && n < 128 && (mem[i + n] != old[i + n] || (i + n + 1 < 256 && mem[i + n + 1] != old[i + n + 1]))) n++; // A single equal byte is cheaper as a literal
+		out[len++] = 0x80 | (n - 1);
+		for(int j = 0 ; j < n ; j++) out[len++] = mem[i + j] ^ old[i + j];
+		i += n;
+	}
+	return len;
+}
+
+static const uint8_t *rewind_unrle(const uint8_t *in, uint8_t *page){ // XOR a coded page into page, returns what follows it
+	for(int i = 0 ; i < 256 ; ){
+		int n = (*in & 0x7F) + 1;
+		if(*in++ & 0x80) for(int j = 0 ; j < n ; j++) page[i + j] ^= *in++;
+		i += n;
+	}
+	return in;
+}
+
+static void rewind_apply(const rewind_point *r){ // XOR the pages of r into the shadow, a key point is the whole memory
+	if(r->key) memset(rewind_shadow, 0, sizeof(rewind_shadow));
+	const uint8_t *in = r->data, *end = r->data + r->len;
+	while(in < end){
+		int p = in[0] | (in[1] << 8);
+		in = rewind_unrle(in + 2, &rewind_shadow[p * 256]);
+	}
+}
+
+static void rewind_drop_oldest(void){ // The oldest key point and the deltas up to the next key point
+	do{
+		rewind_point *r = rewind_at(0);
+		rewind_used -= sizeof(rewind_point) + r->len;
+		rewind_keys -= r->key;
+		free(r->data);
+		rewind_first = (rewind_first + 1) % REWIND_MAX_POINTS;
+		rewind_count--;
+	}while(rewind_count && !rewind_at(0)->key);
+}
+
+/// Take a rewind point now.
+void rewind_take(void){
+	static const uint8_t zero[256];
+	int key = !rewind_count || rewind_since_key + 1 >= REWIND_KEY_EVERY;
+	uint32_t len = 0;
+	for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++){
+		uint8_t *mem = instance_memory(p), *shadow = &rewind_shadow[p * 256];
+		if(!key && !(p < 256 && (pla_written[p] & PLA_WRITTEN_REWIND)) && !memcmp(mem, shadow, 256)) continue; // Not written, and not by the host
+		uint32_t n = rewind_rle(rewind_buffer + len + 2, mem, key ? zero : shadow);
+		if(!key && n == 2 && rewind_buffer[len + 2] == 0x7F && rewind_buffer[len + 3] == 0x7F) continue; // Written but the same again
+		rewind_buffer[len]     = p & 0xFF;
+		rewind_buffer[len + 1] = p >> 8;
+		len += 2 + n;
+		memcpy(shadow, mem, 256);
+	}
+	pla_clear_written(PLA_WRITTEN_REWIND);
+	if(rewind_count == REWIND_MAX_POINTS) rewind_drop_oldest();
+	rewind_point *r = rewind_at(rewind_count);
+	snapshot_take_machine(&r->machine);
+	r->data = malloc(len ? len : 1);
+	if(!r->data){ rewind_since_key = REWIND_KEY_EVERY; return; } // No point this time, the shadow has moved on so the next one is a key point
+	memcpy(r->data, rewind_buffer, len);
+	r->len = len;
+	r->key = key;
+	rewind_count++;
+	rewind_keys += key;
+	rewind_since_key = key ? 0 : rewind_since_key + 1;
+	rewind_used += sizeof(rewind_point) + len;
+	while(rewind_used > rewind_budget && rewind_keys > 1) rewind_drop_oldest(); // Never the last key point
+}
+
+/// Go back to the point that is back points before the last one (or the oldest there is). The points after it are dropped.
+void rewind_back(int back){
+	if(!rewind_count) return;
+	int target = rewind_count - 1 - back, key;
+	if(target < 0) target = 0;
+	for(key = target ; !rewind_at(key)->key ; key--);
+	for(int i = key ; i <= target ; i++) rewind_apply(rewind_at(i));
+	for(int p = 0 ; p < (int)INSTANCE_PAGES ; p++) memcpy(instance_memory(p), &rewind_shadow[p * 256], 256);
+	snapshot_restore_machine(&rewind_at(target)->machine);
+	while(rewind_count > target + 1){
+		rewind_point *r = rewind_at(--rewind_count);
+		rewind_used -= sizeof(rewind_point) + r->len;
+		rewind_keys -= r->key;
+		free(r->data);
+	}
+	rewind_since_key = target - key;
+	pla_clear_written(PLA_WRITTEN_REWIND);
+	sched_at(rewind_event, clockticks6502 + REWIND_FRAMES * VIC_CYCLES_PER_LINE * VIC_RASTER_LINES);
+}
+
+static void rewind_event_take(int param, uint64_t when){
+	(void)param;
+	rewind_take();
+	sched_at(rewind_event, when + REWIND_FRAMES * VIC_CYCLES_PER_LINE * VIC_RASTER_LINES);
+}
+
+/// Take rewind points from now on, and keep up to megabytes of them. Returns 0 if there is no memory.
+int rewind_init(int megabytes){
+	rewind_budget = (size_t)megabytes << 20;
+	rewind_points = calloc(REWIND_MAX_POINTS, sizeof(rewind_point));
+	rewind_buffer = malloc(INSTANCE_PAGES * (2 + 256 + 2));
+	if(!rewind_points || !rewind_buffer){
+		free(rewind_points); free(rewind_buffer);
+		rewind_points = NULL; rewind_buffer = NULL;
+		return 0;
+	}
+	rewind_event = sched_add("Rewind", rewind_event_take, 0);
+	sched_at(rewind_event, clockticks6502);
+	return 1;
+}
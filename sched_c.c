@@ -0,0 +1,109 @@
+// Event scheduler for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after cpu_c.c.
+// Devices don't look at the clock every cycle. Each one registers its events once (sched_add) and then tells the scheduler at what CPU cycle
+// it needs to run next (sched_at). The main loop runs the CPU until sched_next and then calls sched_run, so the CPU loop has no device polling.
+// The events are in a binary min-heap on the cycle. The heap is indexed, so an event can be moved or cancelled without searching for it.
+
+#define SCHED_MAX_EVENTS	32
+#define SCHED_NEVER		UINT64_MAX	// Not scheduled
+
+typedef void (*sched_callback)(int param, uint64_t when); // when is the cycle the event was scheduled for, clockticks6502 may be a few cycles later
+
+typedef struct {
+	uint64_t       when;
+	sched_callback callback;
+	int            param;		// Given to the callback, to tell apart events with the same callback (e.g. timer A or B)
+	int            pos;		// Index in sched_heap, -1 if not scheduled
+	const char    *name;		// For debugging
+} sched_event;
+
+static sched_event sched_events[SCHED_MAX_EVENTS];
+static int         sched_heap[SCHED_MAX_EVENTS];	// Event ids, the earliest first
+static int         sched_events_used;
+static int         sched_heap_size;
+uint64_t           sched_next = SCHED_NEVER;		// Cycle of the earliest event, the CPU can run until this
+
+static void sched_swap(int i, int j){
+	int a = sched_heap[i], b = sched_heap[j];
+	sched_heap[i] = b; sched_events[b].pos = i;
+	sched_heap[j] = a; sched_events[a].pos = j;
+}
+
+static void sched_sift_up(int i){
+	while(i > 0){
+		int parent = (i - 1) / 2;
+		if(sched_events[sched_heap[parent]].when <= sched_events[sched_heap[i]].when) break;
+		sched_swap(i, parent);
+		i = parent;
+	}
+}
+
+static void sched_sift_down(int i){
+	while(1){
+		int least = i, l = i * 2 + 1, r = l + 1;
+		if(l < sched_heap_size && sched_events[sched_heap[l]].when < sched_events[sched_heap[least]].when) least = l;
+		if(r < sched_heap_size && sched_events[sched_heap[r]].when < sched_events[sched_heap[least]].when) least = r;
+		if(least == i) break;
+		sched_swap(i, least);
+		i = least;
+	}
+}
+
+static void sched_update_next(void){ sched_next = sched_heap_size ? sched_events[sched_heap[0]].when : SCHED_NEVER; }
+
+/// Register an event, returns the id to use with sched_at() and sched_cancel(). The event is not scheduled yet.
+int sched_add(const char *name, sched_callback callback, int param){
+	if(sched_events_used == SCHED_MAX_EVENTS){ printf("Too many scheduler events, increase SCHED_MAX_EVENTS\n"); exit(1); }
+	int id = sched_events_used++;
+	sched_events[id].when     = SCHED_NEVER;
+	sched_events[id].callback = callback;
+	sched_events[id].param    = param;
+	sched_events[id].pos      = -1;
+	sched_events[id].name     = name;
+	return id;
+}
+
+void sched_cancel(int id){
+	int i = sched_events[id].pos;
+	if(i < 0) return;
+	sched_events[id].pos  = -1;
+	sched_events[id].when = SCHED_NEVER;
+	if(i != --sched_heap_size){ // Move the last one to the hole
+		sched_heap[i] = sched_heap[sched_heap_size];
+		sched_events[sched_heap[i]].pos = i;
+		sched_sift_up(i);
+		sched_sift_down(sched_events[sched_heap[i]].pos);
+	}
+	sched_update_next();
+}
+
+/// Schedule (or move) an event to a cycle. SCHED_NEVER cancels it.
+void sched_at(int id, uint64_t when){
+	if(when == SCHED_NEVER){ sched_cancel(id); return; }
+	sched_event *e = &sched_events[id];
+	if(e->pos < 0){
+		e->pos = sched_heap_size++;
+		sched_heap[e->pos] = id;
+	}
+	e->when = when;
+	sched_sift_up(e->pos);
+	sched_sift_down(e->pos);
+	sched_update_next();
+}
+
+uint64_t sched_when(int id){ return sched_events[id].when; }
+
+/// Move every scheduled event delta cycles, when clockticks6502 is set to another time (a snapshot is loaded). The order is the same, so the heap is.
+void sched_shift(int64_t delta){
+	for(int i = 0 ; i < sched_heap_size ; i++) sched_events[sched_heap[i]].when += delta;
+	sched_update_next();
+}
+
+/// Run every event that is due at cycle now, in order. The callbacks can schedule new events, also ones that are due already.
+void sched_run(uint64_t now){
+	while(sched_heap_size && sched_events[sched_heap[0]].when <= now){
+		int id = sched_heap[0];
+		uint64_t when = sched_events[id].when;
+		sched_cancel(id);
+		sched_events[id].callback(sched_events[id].param, when);
+	}
+}
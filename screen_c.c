@@ -0,0 +1,89 @@
+// Text screen scraping for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after chrout_c.c.
+// The 40x25 screen the VIC-II shows (bank from CIA #2, address from 0xD018) is read from the RAM and the screen codes are looked up
+// in a table for the char set in use, made once from the PETSCII tables of the CHROUT capture. Colors can be put in the text as {n}
+// where the color changes, and reverse as {R} and {r}. It's a table lookup per char, so it can be done every frame.
+// screen_wait_text() runs the emulation until a text is on the screen, for tests that would otherwise wait a guessed time.
+
+#define SCREEN_COLS	40
+#define SCREEN_ROWS	25
+#define SCREEN_TEXT_MAX	(SCREEN_ROWS * (SCREEN_COLS * (3 + 4 + 3) + 1) + 1)	// UTF-8, a color and reverse for every char, and the newlines
+#define SCREEN_WAIT_EVERY	(VIC_CYCLES_PER_LINE * VIC_RASTER_LINES)	// Look at the screen every frame
+
+static const char *screen_utf8[2][128];		// Screen code -> UTF-8, upper case and lower case char set. Bit 7 is reverse, the same char.
+static const char *const screen_color_tag[16] = { "{0}", "{1}", "{2}", "{3}", "{4}", "{5}", "{6}", "{7}", "{8}", "{9}", "{10}", "{11}", "{12}", "{13}", "{14}", "{15}" };
+int screen_waiting;				// In screen_wait_text(), the headless end waits too
+
+static void screen_init(void){
+	if(screen_utf8[0][0]) return; // Made already
+	chrout_make_lower();
+	for(int c = 0 ; c < 128 ; c++){
+		int petscii = c < 0x20 ? c + 0x40 : c < 0x40 ? c : c < 0x60 ? c + 0x80 : c + 0x40; // The PETSCII code that prints as the screen code
+		screen_utf8[0][c] = chrout_utf8[petscii];
+		screen_utf8[1][c] = chrout_utf8_lower[petscii];
+	}
+}
+
+/// Address of the screen the VIC-II shows.
+uint16_t screen_address(void){
+	int bank = (~(cia[1].pra | ~cia[1].ddra)) & 3;
+	return (bank << 14) | ((vic_reg(0x18) & 0xF0) << 6);
+}
+
+/// The screen as UTF-8 lines into out (SCREEN_TEXT_MAX bytes), with color annotations if colors is set. Spaces at the end of a line are dropped. Returns the length.
+size_t screen_text(char *out, int colors){
+	screen_init();
+	const uint8_t *screen = &sysram[screen_address()];
+	const char *const *utf8 = screen_utf8[(vic_reg(0x18) & 0x02) != 0];
+	size_t len = 0;
+	for(int row = 0 ; row < SCREEN_ROWS ; row++){
+		size_t end = len;
+		int color = -1, reverse = 0;
+		for(int col = 0 ; col < SCREEN_COLS ; col++){
+			int i = row * SCREEN_COLS + col;
+			uint8_t c = screen[i];
+			if(colors){
+				if((color_ram[i] & 0x0F) != color){
+					color = color_ram[i] & 0x0F;
+					for(const char *tag = screen_color_tag[color] ; *tag ; ) out[len++] = *tag++;
+				}
+				if((c >> 7) != reverse){
+					reverse = c >> 7;
+					out[len++] = '{'; out[len++] = reverse ? 'R' : 'r'; out[len++] = '}';
+				}
+			}
+			for(const char *u = utf8[c & 0x7F] ; *u ; ) out[len++] = *u++;
+			if(c != 0x20 && c != 0x60) end = len; // Not a space
+		}
+		len = end;
+		out[len++] = '\n';
+	}
+	out[len] = 0;
+	return len;
+}
+
+/// Print the screen on stdout.
+void screen_print(int colors){
+	static char text[SCREEN_TEXT_MAX];
+	fwrite(text, 1, screen_text(text, colors), stdout);
+	fflush(stdout);
+}
+
+/// Run the emulation until text is on the screen, but at most cycles. Returns 1 if it came.
+int screen_wait_text(const char *text, uint64_t cycles){
+	static char screen[SCREEN_TEXT_MAX];
+	uint64_t until = clockticks6502 + cycles, look = clockticks6502;
+	int found = 0;
+	screen_waiting = 1;
+	while(1){
+		if(clockticks6502 >= look){
+			screen_text(screen, 0);
+			if((found = strstr(screen, text) != NULL) || clockticks6502 >= until) break;
+			look = clockticks6502 + SCREEN_WAIT_EVERY;
+			if(look > until) look = until;
+		}
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+	screen_waiting = 0;
+	return found;
+}
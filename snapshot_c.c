@@ -0,0 +1,155 @@
+// Machine snapshots for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, after cart_c.c.
+// A snapshot is the CPU, the RAM, the color RAM, the I/O shadow, the CIA and VIC-II state and the PLA lines, in one struct that is written as it is.
+// Loading maps the file and copies the blocks out of it, so the KERNAL cold start (RAM test, BASIC init, screen clear) doesn't have to run every time.
+// The struct is not portable, a snapshot is for the build that made it (the size is checked together with the version).
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC		"C64SNAP"
+#define SNAPSHOT_VERSION	1
+#define SNAPSHOT_BOOT_MAX	(CIA_CLOCK * 10)	// Cycles to wait for READY, a cart may never get there
+
+typedef struct { // Everything but the memory
+	uint16_t pc;				// CPU
+	uint8_t  sp, a, x, y, cpustatus;
+	uint8_t  irq_lines, nmi_lines, int_pending;
+	uint64_t clockticks, instructions;
+	cia_chip cia[2];
+	uint64_t tod_when[2];			// Next TOD tick of the CIAs, the timers have their underflow in cia_chip
+	uint16_t vic_raster;
+	uint64_t vic_when;			// Start of the next raster line
+	uint8_t  pla_game, pla_exrom;
+	int      cart_type, cart_bank;		// The cart must be the same one, it's not in the snapshot
+	uint8_t  cart_ram[256];
+} snapshot_machine;
+
+typedef struct {
+	char     magic[8];
+	uint32_t version;
+	uint32_t size;				// sizeof(snapshot_state)
+	snapshot_machine machine;
+	uint8_t  sysram[0x10000];
+	uint8_t  color_ram[1024];
+	uint8_t  shaddow_io[0x1000];
+} snapshot_state;
+
+/// Copy the CPU and the chips into m.
+void snapshot_take_machine(snapshot_machine *m){
+	m->pc = pc; m->sp = sp; m->a = a; m->x = x; m->y = y; m->cpustatus = cpustatus;
+	m->irq_lines    = irq_lines;
+	m->nmi_lines    = nmi_lines;
+	m->int_pending  = int_pending;
+	m->clockticks   = clockticks6502;
+	m->instructions = instructions6502;
+	memcpy(m->cia, cia, sizeof(cia));
+	for(int n = 0 ; n < 2 ; n++) m->tod_when[n] = sched_when(cia[n].tod_event);
+	m->vic_raster   = vic_raster;
+	m->vic_when     = sched_when(vic_line_event);
+	m->pla_game     = pla_game;
+	m->pla_exrom    = pla_exrom;
+	m->cart_type    = cart_type;
+	m->cart_bank    = cart_bank_now;
+	memcpy(m->cart_ram, cart_ram, sizeof(cart_ram));
+}
+
+/// Copy the machine into s.
+void snapshot_take(snapshot_state *s){
+	memcpy(s->magic, SNAPSHOT_MAGIC, sizeof(s->magic));
+	s->version = SNAPSHOT_VERSION;
+	s->size    = sizeof(snapshot_state);
+	snapshot_take_machine(&s->machine);
+	memcpy(s->sysram,     sysram,     sizeof(sysram));
+	memcpy(s->color_ram,  color_ram,  sizeof(color_ram));
+	memcpy(s->shaddow_io, shaddow_io, sizeof(shaddow_io));
+}
+
+/// Returns 0 if s is not a snapshot this build can restore, the reason is printed.
+static int snapshot_check(const snapshot_state *s, const char *name){
+	if(memcmp(s->magic, SNAPSHOT_MAGIC, sizeof(s->magic))){ printf("%s is not a snapshot\n", name); return 0; }
+	if(s->version != SNAPSHOT_VERSION || s->size != sizeof(snapshot_state)){ printf("%s is a snapshot from another version\n", name); return 0; }
+	if(s->machine.cart_type != cart_type){ printf("%s was saved with another cartridge\n", name); return 0; }
+	return 1;
+}
+
+/// Set the CPU and the chips to m, after the memory is set (the PLA map depends on 0x01).
+/// The host side events (frame, paste, program load...) are moved to the new clock, and the keys held down stay down.
+void snapshot_restore_machine(const snapshot_machine *m){
+	sched_shift((int64_t)(m->clockticks - clockticks6502));
+	pc = m->pc; sp = m->sp; a = m->a; x = m->x; y = m->y; cpustatus = m->cpustatus;
+	irq_lines        = m->irq_lines;
+	nmi_lines        = (m->nmi_lines & ~NMI_RESTORE) | (nmi_lines & NMI_RESTORE); // RESTORE is the host keyboard
+	int_pending      = m->int_pending;
+	clockticks6502   = m->clockticks;
+	instructions6502 = m->instructions;
+	for(int n = 0 ; n < 2 ; n++){ // The event ids are this run's
+		int timer_event[2] = { cia[n].timer_event[0], cia[n].timer_event[1] }, tod_event = cia[n].tod_event;
+		cia[n] = m->cia[n];
+		cia[n].timer_event[0] = timer_event[0];
+		cia[n].timer_event[1] = timer_event[1];
+		cia[n].tod_event      = tod_event;
+		sched_at(timer_event[0], cia[n].underflow[0]);
+		sched_at(timer_event[1], cia[n].underflow[1]);
+		sched_at(tod_event, m->tod_when[n]);
+	}
+	vic_raster = m->vic_raster;
+	sched_at(vic_line_event, m->vic_when);
+	pla_game  = m->pla_game;
+	pla_exrom = m->pla_exrom;
+	if(cart_type >= 0){
+		memcpy(cart_ram, m->cart_ram, sizeof(cart_ram));
+		cart_bank(m->cart_bank);
+	}
+	pla_update();
+}
+
+/// Set the machine to s.
+void snapshot_restore(const snapshot_state *s){
+	memcpy(sysram,     s->sysram,     sizeof(sysram));
+	memcpy(color_ram,  s->color_ram,  sizeof(color_ram));
+	memcpy(shaddow_io, s->shaddow_io, sizeof(shaddow_io));
+	snapshot_restore_machine(&s->machine);
+}
+
+/// Write the machine to a file. Returns 0 on error.
+int snapshot_save(const char *name){
+	snapshot_state *s = malloc(sizeof(snapshot_state));
+	if(!s) return 0;
+	snapshot_take(s);
+	FILE *f = fopen(name, "wb");
+	int ok = f && fwrite(s, sizeof(snapshot_state), 1, f) == 1;
+	if(f && fclose(f)) ok = 0;
+	free(s);
+	if(!ok) printf("Can't write %s\n", name);
+	return ok;
+}
+
+/// Load a snapshot file, it's mapped and copied from. Returns 0 if it can't be used (the reason is printed).
+int snapshot_load(const char *name){
+	int fd = open(name, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st)){ printf("Can't read %s\n", name); if(fd >= 0) close(fd); return 0; }
+	if(st.st_size != sizeof(snapshot_state)){ printf("%s is not a snapshot for this version\n", name); close(fd); return 0; }
+	const snapshot_state *s = mmap(NULL, sizeof(snapshot_state), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(s == MAP_FAILED){ printf("Can't read %s\n", name); return 0; }
+	int ok = snapshot_check(s, name);
+	if(ok) snapshot_restore(s);
+	munmap((void*)s, sizeof(snapshot_state));
+	return ok;
+}
+
+/// Start at READY from the snapshot at name. If there is none (or it's from another version) the machine boots and it's saved when BASIC is READY.
+/// Call after reset6502() and the chip inits, and before anything is set to happen at READY.
+void snapshot_boot(const char *name){
+	if(!access(name, F_OK) && snapshot_load(name)) return;
+	uint64_t until = clockticks6502 + SNAPSHOT_BOOT_MAX;
+	while(!editor_waiting()){ // The chips are the only events yet, so READY is seen within a raster line
+		if(clockticks6502 > until){ printf("BASIC didn't get READY, no snapshot is saved\n"); return; }
+		run6502(&sched_next);
+		sched_run(clockticks6502);
+	}
+	snapshot_save(name);
+}
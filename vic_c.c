@@ -0,0 +1,412 @@
+// VIC-II emulation for the C64 BASIC emulator. Is included by C64_BASIC_EMU.c, like cpu_c.c.
+// The display is rendered one raster line at a time, from the registers as they are when that line is reached, just like the real chip.
+// The registers lives in shaddow_io[0x00 - 0x3F] (the hacking cartridge copy of all I/O writes), so a write to a mirror is stored at the real register.
+// Every graphics mode has it's own inner loop and uses lookup tables for the bit to pixel expansion, so there is no per pixel branching.
+// Sprites are drawn on top of the line. Collisions are found with 64 bit masks over the line (one bit per pixel), not by comparing pixels.
+
+#define VIC_RASTER_LINES	312	// PAL raster lines per frame
+#define VIC_CYCLES_PER_LINE	63	// PAL CPU cycles per raster line, 19656 per frame
+#define VIC_FIRST_DISPLAY_LINE	0x33	// First raster line of the 25 row display window (RSEL=1)
+#define VIC_DISPLAY_LINES	200	// Lines in the display window
+#define VIC_DISPLAY_WIDTH	320	// Pixels in the display window
+#define VIC_FRAME_WIDTH		384	// The visible PAL frame with border...
+#define VIC_FRAME_LINES		272	// ...
+#define VIC_FRAME_FIRST_LINE	16	// ...starts at this raster line...
+#define VIC_BORDER_LEFT		32	// ...and has this many border pixels to the left of the display window.
+
+#define vic_reg(n) shaddow_io[(n)]	// VIC-II register n (0x00 - 0x3F)
+
+uint16_t vic_raster;			// Current raster line (0 - 311)
+uint32_t *vic_frame;			// Where the frame is drawn, VIC_DISPLAY_WIDTH or VIC_FRAME_WIDTH (with border) pixels per line...
+int       vic_frame_pitch;		// ...and this many pixels between the lines.
+static int vic_frame_top;		// Raster line that is the first line in vic_frame
+static int vic_frame_lines;		// Lines in vic_frame
+static int vic_frame_left;		// Border pixels to the left of the display window in vic_frame (0 without border)
+int vic_skip_render;			// Don't draw, when fast forwarding. The raster and the sprite collisions still runs (the foreground is fetched, not drawn).
+int vic_no_frames;			// Never draw, nothing shows the frames (headless)
+static int vic_line_event;		// Scheduler event at the start of every raster line
+
+static const uint8_t *vic_page[64];	// The 16 KB the VIC-II sees, in 256 byte pages. The character ROM shows up at 0x1000 - 0x1FFF in bank 0 and 2.
+static int vic_bank = -1;		// Bank that vic_page[] is set up for.
+#define VIC_MEM(a) (vic_page[((a) >> 8) & 0x3F][(a) & 0xFF]) // Read a byte from the VIC-II 14 bit address space.
+
+static uint32_t vic_hires_mask[256][8];	// Bit pattern -> 8 pixel masks (0 or 0xFFFFFFFF)
+static uint8_t  vic_mc_index[256][4];	// Bit pattern -> 4 double wide multicolor pixels (0 - 3)
+
+static uint8_t  vic_mc_fg[256];		// Bit pattern -> which pixels that counts as foreground in multicolor (bit pair 10 and 11)
+static uint16_t vic_double8[256];	// Bit pattern -> every bit doubled, for sprite X expansion
+
+static uint32_t vic_linebuf[VIC_DISPLAY_WIDTH + 16]; // One line of graphics before fine X scrolling.
+static uint8_t  vic_fgbits[40];		// Foreground pixels of every cell in the line, for sprite priority and collisions.
+
+#define VIC_SPRITE_X0	24	// Sprite X coordinate of the first pixel in the display window
+#define VIC_MASK_WORDS	8	// A line as bits in sprite X coordinates (0 - 511), the MSB of word 0 is X = 0
+
+typedef struct {
+	uint64_t m[2];		// The pixels the sprite covers on the line, from the start of word
+	int word;		// First word in the line mask
+	int x;			// X coordinate (0 - 511)
+	uint32_t data;		// 24 bits of sprite data for this line
+} vic_sprite_line;
+
+// Register names, only used when tracing I/O.
+static const char *vic_reg_name[0x40] = {
+	"X-coord Sprite 0", "Y-coord Sprite 0", "X-Coord Sprite 1", "Y-Coord Sprite 1", "X-Coord Sprite 2", "Y-Coord Sprite 2", "X-Coord Sprite 3", "Y-Coord Sprite 3",
+	"X-Coord Sprite 4", "Y-Coord Sprite 4", "X-Coord Sprite 5", "Y-Coord Sprite 5", "X-Coord Sprite 6", "Y-Coord Sprite 6", "X-Coord Sprite 7", "Y-Coord Sprite 7",
+	"MSB:s of X-coords", "Control register 1", "Raster row counter", "Light pen X", "Light pen Y", "Sprite enabled", "Control register 2", "Sprite Y expansion",
+	"Memory pointers", "Interrupt register", "Interrupt enabled", "Sprite data priority", "Sprite multicolour", "Sprite X expansion", "Sprite-sprite collision", "Sprite-data collision",
+	"Border color", "Background color 0", "Background color 1", "Background color 2", "Background color 3", "Sprite multicolor 0", "Sprite multicolor 1", "Sprite 0 color",
+	"Sprite 1 color", "Sprite 2 color", "Sprite 3 color", "Sprite 4 color", "Sprite 5 color", "Sprite 6 color", "Sprite 7 color", "Unused",
+	"Unused", "Unused", "Unused", "Unused", "Unused", "Unused", "Unused", "Unused",
+	"Unused", "Unused", "Unused", "Unused", "Unused", "Unused", "Unused", "Unused"
+};
+
+void vic_init(uint32_t *frame, int pitch, int border){ // border = 0 draws only the 320x200 display window, otherwise the 384x272 PAL frame
+	vic_frame = frame;
+	vic_frame_pitch = pitch;
+	vic_frame_top   = border ? VIC_FRAME_FIRST_LINE : VIC_FIRST_DISPLAY_LINE;
+	vic_frame_lines = border ? VIC_FRAME_LINES      : VIC_DISPLAY_LINES;
+	vic_frame_left  = border ? VIC_BORDER_LEFT      : 0;
+	vic_raster = VIC_RASTER_LINES - 1; // The first line event starts the frame at line 0
+	vic_bank = -1;
+	for(int b = 0 ; b < 256 ; b++){ // Build the bit expansion tables
+		for(int i = 0 ; i < 8 ; i++) vic_hires_mask[b][i] = (b & (0x80 >> i)) ? 0xFFFFFFFF : 0;
+		for(int i = 0 ; i < 4 ; i++) vic_mc_index[b][i] = (b >> (6 - i * 2)) & 3;
+		uint8_t hi = b & 0xAA;				// The high bit of every pair...
+		vic_mc_fg[b] = hi | (hi >> 1);			// ...makes both pixels foreground
+		vic_double8[b] = 0;
+		for(int i = 0 ; i < 8 ; i++) if(b & (1 << i)) vic_double8[b] |= 3 << (i * 2);
+	}
+}
+
+static void vic_map_bank(int bank){ // Point vic_page[] to the 16 KB bank selected by CIA #2
+	for(int i = 0 ; i < 64 ; i++){
+		if(!(bank & 1) && (i >> 4) == 1)	vic_page[i] = &characters[(i & 0x0F) << 8];	// CHARACTER ROM at 0x1000 in bank 0 and 2
+		else					vic_page[i] = &sysram[(bank << 14) | (i << 8)];	// RAM
+	}
+	vic_bank = bank;
+}
+
+int vic_irq(void){ return (vic_reg(0x19) & vic_reg(0x1A) & 0x0F) != 0; } // The IRQ output: raster, sprite-data, sprite-sprite and light pen
+
+static void vic_irq_output(void){ irq_set(IRQ_VIC, vic_irq()); } // After $D019 or $D01A changed
+
+uint8_t vic_read(uint8_t reg){ // CPU read from a VIC-II register
+	uint8_t value;
+	switch(reg){
+		case 0x1E: // Collision registers are cleared when they are read
+		case 0x1F: value = vic_reg(reg); vic_reg(reg) = 0; return value;
+		case 0x11: return (vic_reg(0x11) & 0x7F) | ((vic_raster >> 1) & 0x80);	// Bit 7 is bit 8 of the raster counter
+		case 0x12: return vic_raster & 0xFF;					// The raster counter, writes goes to the raster compare
+		case 0x16: return vic_reg(0x16) | 0xC0;
+		case 0x18: return vic_reg(0x18) | 0x01;
+		case 0x19: return vic_reg(0x19) | 0x70 | (vic_irq() ? 0x80 : 0);		// Bit 7 is set when any enabled interrupt is flagged
+		case 0x1A: return vic_reg(0x1A) | 0xF0;
+	}
+	if(reg >= 0x20 && reg <= 0x2E) return vic_reg(reg) | 0xF0;	// Colors are 4 bit
+	if(reg >= 0x2F) return 0xFF;					// Unused, $FF on reading
+	return vic_reg(reg);
+}
+
+void vic_write(uint8_t reg, uint8_t value){ // CPU write to a VIC-II register
+	if(reg == 0x1E || reg == 0x1F) return; // Collision registers can't be written
+	if(reg == 0x19){ vic_reg(0x19) &= ~value; vic_irq_output(); return; } // Writing a 1 acknowledges the interrupt
+	vic_reg(reg) = value;
+	if(reg == 0x1A) vic_irq_output();
+}
+
+// ------------------------------------------------------------------------------------------------
+//   The graphics modes. One line of 40 cells each, drawn to px. row is the text row, cline the line in the cell.
+
+static void vic_line_text(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // Standard text mode
+	uint32_t bg = c64_palette[vic_reg(0x21) & 0x0F];
+	const uint8_t *color = &color_ram[row * 40];
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		uint8_t code = VIC_MEM(screen + row * 40 + col);
+		uint8_t bits = vic_fgbits[col] = VIC_MEM(chars + code * 8 + cline);
+		const uint32_t *mask = vic_hires_mask[bits];
+		uint32_t diff = bg ^ c64_palette[color[col] & 0x0F];
+		for(int i = 0 ; i < 8 ; i++) px[i] = bg ^ (diff & mask[i]);
+	}
+}
+
+static void vic_line_text_mc(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // Multicolor text mode
+	uint32_t colors[4] = { c64_palette[vic_reg(0x21) & 0x0F], c64_palette[vic_reg(0x22) & 0x0F], c64_palette[vic_reg(0x23) & 0x0F], 0 };
+	const uint8_t *color = &color_ram[row * 40];
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		uint8_t bits = VIC_MEM(chars + VIC_MEM(screen + row * 40 + col) * 8 + cline);
+		if(color[col] & 0x08){ // Bit 3 in color RAM selects multicolor for this cell
+			colors[3] = c64_palette[color[col] & 0x07];
+			vic_fgbits[col] = vic_mc_fg[bits];
+			const uint8_t *index = vic_mc_index[bits];
+			for(int i = 0 ; i < 4 ; i++) px[i * 2] = px[i * 2 + 1] = colors[index[i]];
+		}else{
+			vic_fgbits[col] = bits;
+			const uint32_t *mask = vic_hires_mask[bits];
+			uint32_t diff = colors[0] ^ c64_palette[color[col] & 0x07];
+			for(int i = 0 ; i < 8 ; i++) px[i] = colors[0] ^ (diff & mask[i]);
+		}
+	}
+}
+
+static void vic_line_ecm(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // Extended background color text mode
+	const uint8_t *color = &color_ram[row * 40];
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		uint8_t code = VIC_MEM(screen + row * 40 + col);
+		uint32_t bg = c64_palette[vic_reg(0x21 + (code >> 6)) & 0x0F]; // Top 2 bits selects background 0 - 3...
+		uint8_t bits = vic_fgbits[col] = VIC_MEM(chars + (code & 0x3F) * 8 + cline); // ...so only 64 characters
+		const uint32_t *mask = vic_hires_mask[bits];
+		uint32_t diff = bg ^ c64_palette[color[col] & 0x0F];
+		for(int i = 0 ; i < 8 ; i++) px[i] = bg ^ (diff & mask[i]);
+	}
+}
+
+static void vic_line_bitmap(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // Hi-res bitmap mode
+	uint16_t bitmap = chars & 0x2000;
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		uint8_t c = VIC_MEM(screen + row * 40 + col); // Screen RAM holds the colors, high nibble for set bits
+		uint32_t bg = c64_palette[c & 0x0F];
+		uint32_t diff = bg ^ c64_palette[c >> 4];
+		uint8_t bits = vic_fgbits[col] = VIC_MEM(bitmap + row * 320 + col * 8 + cline);
+		const uint32_t *mask = vic_hires_mask[bits];
+		for(int i = 0 ; i < 8 ; i++) px[i] = bg ^ (diff & mask[i]);
+	}
+}
+
+static void vic_line_bitmap_mc(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // Multicolor bitmap mode
+	uint16_t bitmap = chars & 0x2000;
+	const uint8_t *color = &color_ram[row * 40];
+	uint32_t colors[4];
+	colors[0] = c64_palette[vic_reg(0x21) & 0x0F];
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		uint8_t c = VIC_MEM(screen + row * 40 + col);
+		colors[1] = c64_palette[c >> 4];
+		colors[2] = c64_palette[c & 0x0F];
+		colors[3] = c64_palette[color[col] & 0x0F];
+		uint8_t bits = VIC_MEM(bitmap + row * 320 + col * 8 + cline);
+		vic_fgbits[col] = vic_mc_fg[bits];
+		const uint8_t *index = vic_mc_index[bits];
+		for(int i = 0 ; i < 4 ; i++) px[i * 2] = px[i * 2 + 1] = colors[index[i]];
+	}
+}
+
+static void vic_line_invalid(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars){ // ECM together with bitmap or multicolor shows black
+	(void)row; (void)cline; (void)screen; (void)chars;
+	memset(vic_fgbits, 0, sizeof(vic_fgbits));
+	for(int i = 0 ; i < VIC_DISPLAY_WIDTH ; i++) px[i] = c64_palette[0];
+}
+
+// Mode = ECM (bit 2) | BMM (bit 1) | MCM (bit 0)
+static void (*const vic_modes[8])(uint32_t *px, int row, int cline, uint16_t screen, uint16_t chars) = {
+	vic_line_text, vic_line_text_mc, vic_line_bitmap, vic_line_bitmap_mc,
+	vic_line_ecm,  vic_line_invalid, vic_line_invalid, vic_line_invalid
+};
+
+static void vic_line_fgbits(int mode, int row, int cline, uint16_t screen, uint16_t chars){ // Only vic_fgbits of the modes above, for a line that isn't drawn
+	const uint8_t *color = &color_ram[row * 40];
+	for(int col = 0 ; col < 40 ; col++){
+		uint8_t code = VIC_MEM(screen + row * 40 + col), bits = 0;
+		switch(mode){
+			case 0: bits = VIC_MEM(chars + code * 8 + cline); break;
+			case 1: bits = VIC_MEM(chars + code * 8 + cline); if(color[col] & 0x08) bits = vic_mc_fg[bits]; break;
+			case 2: bits = VIC_MEM((chars & 0x2000) + row * 320 + col * 8 + cline); break;
+			case 3: bits = vic_mc_fg[VIC_MEM((chars & 0x2000) + row * 320 + col * 8 + cline)]; break;
+			case 4: bits = VIC_MEM(chars + (code & 0x3F) * 8 + cline); break;
+		}
+		vic_fgbits[col] = bits;
+	}
+}
+
+static void vic_line_idle(uint32_t *px){ // Outside the text rows the VIC-II shows the byte at the end of the bank, in black
+	uint8_t bits = VIC_MEM((vic_reg(0x11) & 0x40) ? 0x39FF : 0x3FFF);
+	const uint32_t *mask = vic_hires_mask[bits];
+	uint32_t bg = c64_palette[vic_reg(0x21) & 0x0F];
+	uint32_t diff = bg ^ c64_palette[0];
+	memset(vic_fgbits, bits, sizeof(vic_fgbits));
+	for(int col = 0 ; col < 40 ; col++, px += 8){
+		for(int i = 0 ; i < 8 ; i++) px[i] = bg ^ (diff & mask[i]);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+//   Sprites
+
+static inline void vic_mask_or(uint64_t *line, int x, uint64_t bits){ // OR bits (MSB first) into a line mask at X coordinate x
+	int w = x >> 6, s = x & 63;
+	line[w] |= bits >> s;
+	if(s && w + 1 < VIC_MASK_WORDS) line[w + 1] |= bits << (64 - s);
+}
+static inline int vic_mask_get(const uint64_t *line, int x){ return (line[x >> 6] >> (63 - (x & 63))) & 1; }
+
+static int vic_sprites_overlap(const vic_sprite_line *a, const vic_sprite_line *b){ // AND of two sprite masks, they are at most 2 words each
+	switch(b->word - a->word){
+		case  0: return ((a->m[0] & b->m[0]) | (a->m[1] & b->m[1])) != 0;
+		case  1: return (a->m[1] & b->m[0]) != 0;
+		case -1: return (a->m[0] & b->m[1]) != 0;
+	}
+	return 0;
+}
+
+// Fetch the sprites that are on this raster line. Returns a bit for every sprite that was found.
+static uint8_t vic_sprites_fetch(uint16_t raster, uint16_t screen, vic_sprite_line *sl){
+	uint8_t found = 0;
+	uint8_t enabled = vic_reg(0x15);
+	for(int n = 0 ; enabled ; n++, enabled >>= 1){
+		if(!(enabled & 1)) continue;
+		int yexp = (vic_reg(0x17) >> n) & 1;
+		int row = (int)raster - (vic_reg(0x01 + n * 2) + 1); // The first line is shown on the raster line after the Y coordinate
+		if(row < 0 || row >= (21 << yexp)) continue;
+		row >>= yexp;
+
+		uint16_t data = VIC_MEM(screen + 0x3F8 + n) * 64 + row * 3; // Sprite pointers are in the last 8 bytes of the video matrix
+		uint32_t d = ((uint32_t)VIC_MEM(data) << 16) | ((uint32_t)VIC_MEM(data + 1) << 8) | VIC_MEM(data + 2);
+		uint32_t cover = d;
+		if((vic_reg(0x1C) >> n) & 1){ cover = (d | (d >> 1)) & 0x555555; cover |= cover << 1; } // Multicolor, every pair that isn't 00 covers both pixels
+
+		uint64_t bits;
+		if((vic_reg(0x1D) >> n) & 1)	bits = ((uint64_t)vic_double8[cover >> 16] << 48) | ((uint64_t)vic_double8[(cover >> 8) & 0xFF] << 32) | ((uint64_t)vic_double8[cover & 0xFF] << 16); // X expansion
+		else				bits = (uint64_t)cover << 40;
+
+		vic_sprite_line *s = &sl[n];
+		s->x = vic_reg(0x00 + n * 2) | (((vic_reg(0x10) >> n) & 1) << 8);
+		s->data = d;
+		s->word = s->x >> 6;
+		s->m[0] = bits >> (s->x & 63);
+		s->m[1] = (s->x & 63) ? bits << (64 - (s->x & 63)) : 0;
+		found |= 1 << n;
+	}
+	return found;
+}
+
+// Sprites for one raster line. Updates the collision registers from vic_fgbits, and draws them to out (display window pixels) if it isn't NULL.
+static void vic_sprites(uint16_t raster, uint16_t screen, uint32_t *out, int xscroll){
+	vic_sprite_line sl[8];
+	uint8_t active = vic_sprites_fetch(raster, screen, sl);
+	if(!active) return;
+
+	uint8_t sprite_hit = 0, data_hit = 0;
+	for(int i = 0 ; i < 8 ; i++){ // Sprite to sprite
+		if(!((active >> i) & 1)) continue;
+		for(int j = i + 1 ; j < 8 ; j++){
+			if(((active >> j) & 1) && vic_sprites_overlap(&sl[i], &sl[j])) sprite_hit |= (1 << i) | (1 << j);
+		}
+	}
+
+	uint64_t fg[VIC_MASK_WORDS] = {0}; // Foreground graphics of the line
+	for(int col = 0 ; col < 40 ; col++) if(vic_fgbits[col]) vic_mask_or(fg, VIC_SPRITE_X0 + xscroll + col * 8, (uint64_t)vic_fgbits[col] << 56);
+	for(int n = 0 ; n < 8 ; n++){ // Sprite to foreground
+		if(!((active >> n) & 1)) continue;
+		const vic_sprite_line *s = &sl[n];
+		uint64_t hit = s->m[0] & fg[s->word];
+		if(s->word + 1 < VIC_MASK_WORDS) hit |= s->m[1] & fg[s->word + 1];
+		if(hit) data_hit |= 1 << n;
+	}
+
+	if(sprite_hit){ if(!vic_reg(0x1E)) vic_reg(0x19) |= 0x04; vic_reg(0x1E) |= sprite_hit; vic_irq_output(); } // Interrupt flag is set by the first collision
+	if(data_hit)  { if(!vic_reg(0x1F)) vic_reg(0x19) |= 0x02; vic_reg(0x1F) |= data_hit;   vic_irq_output(); }
+	if(!out) return;
+
+	uint64_t taken[VIC_MASK_WORDS] = {0}; // Pixels already owned by a sprite with a lower number (higher priority)
+	uint32_t mc[4] = { 0, c64_palette[vic_reg(0x25) & 0x0F], 0, c64_palette[vic_reg(0x26) & 0x0F] };
+	for(int n = 0 ; n < 8 ; n++){
+		if(!((active >> n) & 1)) continue;
+		const vic_sprite_line *s = &sl[n];
+		int xexp   = (vic_reg(0x1D) >> n) & 1;
+		int multi  = (vic_reg(0x1C) >> n) & 1;
+		int behind = (vic_reg(0x1B) >> n) & 1;
+		mc[2] = c64_palette[vic_reg(0x27 + n) & 0x0F];
+		for(int p = 0 ; p < (24 << xexp) ; p++){
+			int bit = p >> xexp;
+			int index = multi ? (s->data >> (22 - (bit & ~1))) & 3 : ((s->data >> (23 - bit)) & 1) << 1; // Color 2 is the sprite color
+			if(!index) continue;
+			int x = (s->x + p) & 0x1FF;
+			if(vic_mask_get(taken, x)) continue;
+			taken[x >> 6] |= 1ULL << (63 - (x & 63));
+			if(behind && vic_mask_get(fg, x)) continue; // Behind the foreground graphics
+			int dx = x - VIC_SPRITE_X0;
+			if(dx >= 0 && dx < VIC_DISPLAY_WIDTH) out[dx] = mc[index];
+		}
+	}
+}
+
+static void vic_line_collisions(uint16_t raster){ // A line that isn't drawn, the foreground is fetched for the sprite collisions
+	uint8_t d011 = vic_reg(0x11);
+	uint8_t d018 = vic_reg(0x18);
+	int y   = raster - VIC_FIRST_DISPLAY_LINE;
+	int rel = raster - (0x30 + (d011 & 0x07));
+	int bank = (~(cia[1].pra | ~cia[1].ddra)) & 3; // The sprites are fetched from the bank too
+	if(bank != vic_bank) vic_map_bank(bank);
+	if(!(d011 & 0x10) || y < 0 || y >= VIC_DISPLAY_LINES){ // The border has no foreground
+		memset(vic_fgbits, 0, sizeof(vic_fgbits));
+	}else{
+		if(rel < 0 || rel >= 25 * 8) memset(vic_fgbits, VIC_MEM((d011 & 0x40) ? 0x39FF : 0x3FFF), sizeof(vic_fgbits));
+		else vic_line_fgbits(((d011 >> 4) & 0x06) | ((vic_reg(0x16) >> 4) & 0x01), rel >> 3, rel & 7, (d018 & 0xF0) << 6, (d018 & 0x0E) << 10);
+	}
+	vic_sprites(raster, (d018 & 0xF0) << 6, NULL, vic_reg(0x16) & 0x07);
+}
+
+/// Render one raster line. Is called by the line event, once for every line in the frame, in order, while the CPU runs in between.
+void vic_line(uint16_t raster){
+	vic_raster = raster;
+	int fy = raster - vic_frame_top;
+	int y  = raster - VIC_FIRST_DISPLAY_LINE;
+	if(fy < 0 || fy >= vic_frame_lines || !vic_frame || vic_skip_render || vic_no_frames){ // Not drawn, but sprites can still collide
+		if(vic_reg(0x15)) vic_line_collisions(raster);
+		return;
+	}
+
+	uint32_t *out = &vic_frame[fy * vic_frame_pitch + vic_frame_left]; // The display window part of the line
+	uint8_t d011 = vic_reg(0x11);
+	uint8_t d016 = vic_reg(0x16);
+	uint32_t border = c64_palette[vic_reg(0x20) & 0x0F];
+	if(vic_frame_left){ // Side borders
+		ikigui_span_fill(out - vic_frame_left, border, vic_frame_left);
+		ikigui_span_fill(out + VIC_DISPLAY_WIDTH, border, VIC_FRAME_WIDTH - VIC_DISPLAY_WIDTH - vic_frame_left);
+	}
+
+	int bank = (~(cia[1].pra | ~cia[1].ddra)) & 3; // CIA #2 port A bit 0-1 (inverted) selects the 16 KB bank
+	if(bank != vic_bank) vic_map_bank(bank);
+
+	if(!(d011 & 0x10) || y < 0 || y >= VIC_DISPLAY_LINES){ // Display disabled (DEN) or upper/lower border, all border color
+		ikigui_span_fill(out, border, VIC_DISPLAY_WIDTH);
+		if(vic_reg(0x15)){ memset(vic_fgbits, 0, sizeof(vic_fgbits)); vic_sprites(raster, (vic_reg(0x18) & 0xF0) << 6, NULL, 0); } // No foreground to collide with
+		return;
+	}
+
+	int xscroll = d016 & 0x07;
+	uint32_t bg = c64_palette[vic_reg(0x21) & 0x0F];
+	for(int i = 0 ; i < xscroll ; i++) vic_linebuf[i] = bg; // Fine scroll, the graphics moves right and background fills in from the left
+
+	int rel = raster - (0x30 + (d011 & 0x07)); // Fine Y scroll, the first text row starts when the raster matches YSCROLL
+	if(rel < 0 || rel >= 25 * 8){
+		vic_line_idle(&vic_linebuf[xscroll]);
+	}else{
+		uint8_t  d018   = vic_reg(0x18);
+		uint16_t screen = (d018 & 0xF0) << 6;	// Video matrix, 1 KB steps
+		uint16_t chars  = (d018 & 0x0E) << 10;	// Character set 2 KB steps, or bitmap 8 KB steps
+		int mode = ((d011 >> 4) & 0x06) | ((d016 >> 4) & 0x01);
+		vic_modes[mode](&vic_linebuf[xscroll], rel >> 3, rel & 7, screen, chars);
+	}
+	memcpy(out, vic_linebuf, VIC_DISPLAY_WIDTH * sizeof(uint32_t));
+	if(vic_reg(0x15)) vic_sprites(raster, (vic_reg(0x18) & 0xF0) << 6, out, xscroll); // Nothing to do if no sprite is enabled
+
+	if(!(d011 & 0x08) && (y < 4 || y >= VIC_DISPLAY_LINES - 4)){ // 24 rows (RSEL=0), the border covers 4 lines at the top and bottom
+		ikigui_span_fill(out, border, VIC_DISPLAY_WIDTH);
+	}else if(!(d016 & 0x08)){ // 38 columns (CSEL=0), the border covers 7 pixels to the left and 9 to the right
+		for(int i = 0 ; i < 7 ; i++) out[i] = border;
+		for(int i = VIC_DISPLAY_WIDTH - 9 ; i < VIC_DISPLAY_WIDTH ; i++) out[i] = border;
+	}
+}
+
+static void vic_event_line(int param, uint64_t when){ // Start of a raster line
+	(void)param;
+	uint16_t raster = vic_raster + 1 == VIC_RASTER_LINES ? 0 : vic_raster + 1;
+	vic_line(raster);
+	if(raster == (((vic_reg(0x11) & 0x80) << 1) | vic_reg(0x12))){ vic_reg(0x19) |= 0x01; vic_irq_output(); } // Raster compare ($D011 bit 7 and $D012 writes)
+	sched_at(vic_line_event, when + VIC_CYCLES_PER_LINE);
+}
+
+void vic_start(void){ // Register the raster line event, the first line starts now
+	vic_line_event = sched_add("VIC-II line", vic_event_line, 0);
+	sched_at(vic_line_event, clockticks6502);
+}